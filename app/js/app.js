@@ -88,16 +88,125 @@ var Container = React.createClass({
   }
 });
 
+//sequence number of the last edit sent, and of the last edit acknowledged by the server
+var lastSeq = 0;
+var ackedSeq = 0;
+//sequence number of the last edit of each element, whose echoes are ignored until it is acknowledged
+var editSeqs = {};
+
+//with "?trace", the edits carry the time at which they were made, for measuring the latency on the server
+var traceLatency = /[?&]trace([=&#]|$)/.test(window.location.search);
+
 var makeUpdateJson = function(ident,val)
 {
-  return {
+  lastSeq++;
+  editSeqs[ident] = lastSeq;
+  var message = {
     "type":"update", 
+    "seq":lastSeq,
     "content":[ 
       { 
         id: ident,
         value: val
        } 
       ]};
+  if(traceLatency)
+  {
+    message.t = Date.now();
+  }
+  return message;
+}
+
+//name of the websocket subprotocol of the binary value frames (see src/InstantInterface/BinaryProtocol.h)
+var binaryProtocol = "instantinterface.binary";
+//elements of the current structure indexed by their handle
+var elementsByHandle = [];
+
+//nodes of a group, the root of the structure being the list of its nodes itself
+var getContent = function(group){
+  return Array.isArray(group) ? group : group.content;
+}
+
+var indexHandles = function(group){
+  var content = getContent(group);
+  for(var i = 0; i<content.length; i++)
+  {
+    var node = content[i];
+    if(node.type == "group"){ indexHandles(node);}
+    else if(node.handle !== undefined){ elementsByHandle[node.handle] = node;}
+  }
+}
+
+//sends the new value of an element, in a binary frame if the binary protocol has been negotiated (strings are always sent in json)
+var sendUpdate = function(element, value){
+  var sizes = {"a":0, "b":1, "i":4, "f":4, "d":8};
+  var size = sizes[element.valueType];
+  if(ws.protocol != binaryProtocol || element.handle === undefined || size === undefined)
+  {
+    ws.send(JSON.stringify(makeUpdateJson(element.id, value)));
+    return;
+  }
+
+  var view;
+  if(element.valueType == "a")
+  {
+    view = new DataView(new ArrayBuffer(5));
+    view.setUint8(0, 2);
+    view.setUint32(1, element.handle, true);
+  }
+  else
+  {
+    view = new DataView(new ArrayBuffer(6 + size));
+    view.setUint8(0, 1);
+    view.setUint32(1, element.handle, true);
+    view.setUint8(5, element.valueType.charCodeAt(0));
+    if(element.valueType == "b"){ view.setUint8(6, value ? 1 : 0);}
+    else if(element.valueType == "i"){ view.setInt32(6, value, true);}
+    else if(element.valueType == "f"){ view.setFloat32(6, value, true);}
+    else { view.setFloat64(6, value, true);}
+  }
+  ws.send(view.buffer);
+}
+
+//applies a binary update message: records (handle, tag, value)
+var applyBinaryUpdate = function(buffer){
+  var view = new DataView(buffer);
+  if(view.byteLength < 1 || view.getUint8(0) != 1){ return;}
+  var pos = 1;
+  while(pos + 5 <= view.byteLength)
+  {
+    var handle = view.getUint32(pos, true);
+    var tag = String.fromCharCode(view.getUint8(pos + 4));
+    var element = elementsByHandle[handle];
+    var value;
+    pos += 5;
+    if(tag == "b"){ value = view.getUint8(pos) != 0; pos += 1;}
+    else if(tag == "i"){ value = view.getInt32(pos, true); pos += 4;}
+    else if(tag == "f"){ value = view.getFloat32(pos, true); pos += 4;}
+    else if(tag == "d"){ value = view.getFloat64(pos, true); pos += 8;}
+    else if(tag == "q")
+    {
+      //float quantized on 16 bits in [min, max]
+      var q = view.getUint16(pos, true);
+      value = element ? element.min + (element.max - element.min) * q / 65535 : 0;
+      pos += 2;
+    }
+    else if(tag == "s")
+    {
+      var length = view.getUint32(pos, true);
+      value = new TextDecoder("utf-8").decode(new Uint8Array(buffer, pos + 4, length));
+      pos += 4 + length;
+    }
+    else
+    {
+      return;
+    }
+
+    if(element && typeof setters[element.id] === "function")
+    {
+      setters[element.id](value);
+    }
+  }
 }
 
 var sliderContainerStyle = 
@@ -151,8 +260,7 @@ var IntSlider = React.createClass({
   
   communicateChange: function (newValue)
   {
-    var data = makeUpdateJson(this.props.json.id, newValue);
-    ws.send(JSON.stringify(data));
+    sendUpdate(this.props.json, newValue);
   },
   
   convertValue: function(value)
@@ -208,8 +316,7 @@ var FloatSlider = React.createClass({
   
   communicateChange: function (newValue)
   {
-    var data = makeUpdateJson(this.props.json.id, newValue);
-    ws.send(JSON.stringify(data));
+    sendUpdate(this.props.json, newValue);
   },
   
   convertValue: function(value)
@@ -268,8 +375,7 @@ var BoolToggle = React.createClass({
   
   communicateChange: function (newValue)
   {
-    var data = makeUpdateJson(this.props.json.id, newValue);
-    ws.send(JSON.stringify(data));
+    sendUpdate(this.props.json, newValue);
   },
   
   convertValue: function(value)
@@ -294,8 +400,7 @@ var Action = React.createClass({
   
   applyAction: function(e)
   {
-    var data = makeUpdateJson(this.props.json.id, null);
-    ws.send(JSON.stringify(data));
+    sendUpdate(this.props.json, null);
   },
  
   render: function()
@@ -365,38 +470,169 @@ var getWSUrl = function(){
   return ws_url;
 }
 
+//groups whose values are received, given as "?groups=path1,path2" (all the groups if absent)
+var getSubscriptions = function(){
+  var match = /[?&]groups=([^&#]*)/.exec(window.location.search);
+  if(!match){ return [];}
+  return decodeURIComponent(match[1]).split(",").filter(function(path){ return path.length > 0;});
+}
+
+//structure stored at the last download, null if there is none
+var getCachedStructure = function(){
+  try
+  {
+    var structure = localStorage.getItem("structure");
+    return structure ? JSON.parse(structure) : null;
+  }
+  catch(e)
+  {
+    return null;
+  }
+}
+
+//group of the structure with the path given by the server ("" is the root group), null if there is none
+var findGroup = function(group, path){
+  if((Array.isArray(group) ? "" : group.path) == path)
+  {
+    return group;
+  }
+  var content = getContent(group);
+  for(var i = 0; i<content.length; i++)
+  {
+    var node = content[i];
+    var found = node.type == "group" ? findGroup(node, path) : null;
+    if(found){ return found;}
+  }
+  return null;
+}
+
+//structure currently displayed
+var currentStructure = null;
+var currentHash = null;
+
+//run of the server and last state version received, from which the values are resumed after a reconnection
+var session = null;
+var lastVersion = 0;
+
+var showStructure = function(structure, hash){
+  currentStructure = structure;
+  currentHash = hash;
+  elementsByHandle = [];
+  indexHandles(structure);
+  if(hash)
+  {
+    try
+    {
+      localStorage.setItem("structure", JSON.stringify(structure));
+      localStorage.setItem("structureHash", hash);
+    }
+    catch(e) {}
+  }
+  ReactDOM.render(<Generator json={structure}/>,document.getElementById('example'));
+}
+
 //ask through websocket for the json that will define the interface
 
-var a = function(){
+var connect = function(){
   var ws_url = getWSUrl();
   
   if("WebSocket" in window)
   {
-    ws = new WebSocket(ws_url);
+    //the values are exchanged in binary frames with "?binary"
+    if(/[?&]binary([=&#]|$)/.test(window.location.search))
+    {
+      ws = new WebSocket(ws_url, [binaryProtocol]);
+      ws.binaryType = "arraybuffer";
+    }
+    else
+    {
+      ws = new WebSocket(ws_url);
+    }
     
     ws.onopen = function()
     {
-      ws.send("send_interface");
+      var subscriptions = getSubscriptions();
+      for(var i = 0; i<subscriptions.length; i++)
+      {
+        ws.send("subscribe " + subscriptions[i]);
+      }
+      //the structure can be patched instead of being downloaded again when it changes
+      ws.send("accept_patches");
+      //the edits sent on a previous connection won't be acknowledged anymore
+      ackedSeq = lastSeq;
+      if(session && lastVersion > 0 && currentHash)
+      {
+        //only the values changed since the connection was lost are sent back
+        ws.send("resume " + session + " " + lastVersion + " " + currentHash);
+        return;
+      }
+      //the structure received at the last visit is only downloaded again if it has changed
+      var cachedHash = getCachedStructure() ? localStorage.getItem("structureHash") : null;
+      ws.send(cachedHash ? "send_interface " + cachedHash : "send_interface");
     }
     
     ws.onmessage = function(evt)
     {
+      if(evt.data instanceof ArrayBuffer)
+      {
+        applyBinaryUpdate(evt.data);
+        return;
+      }
       var message = JSON.parse(evt.data);
 
       if(message.type == "interface")
       {
         console.log(message.content);
-        ReactDOM.render(<Generator json={message.content}/>,document.getElementById('example'));
+        session = message.session;
+        showStructure(message.content, message.hash);
+      }
+      else if(message.type == "unchanged")
+      {
+        //the values are sent right after
+        session = message.session;
+        showStructure(currentHash == message.hash ? currentStructure : getCachedStructure(), message.hash);
+      }
+      else if(message.type == "patch")
+      {
+        //the patch only applies to the structure it has been computed from
+        var patched = currentStructure && currentHash == message.base;
+        for(var i = 0; patched && i<message.content.length; i++)
+        {
+          var edit = message.content[i];
+          var group = findGroup(currentStructure, edit.group);
+          if(edit.op == "insert" && group)
+          {
+            getContent(group).push(edit.node);
+          }
+          else
+          {
+            patched = false;
+          }
+        }
+        if(patched)
+        {
+          showStructure(currentStructure, message.hash);
+        }
+        else
+        {
+          ws.send("send_interface");
+        }
       }
       else if (message.type == "update")
       {
+        if(message.version)
+        {
+          lastVersion = Math.max(lastVersion, message.version);
+        }
         for(var i =0; i<message.content.length; i++)
         {
           var paramUpdate = message.content[i];
           var attrId = paramUpdate["id"];
           
           var fun = setters[attrId];
-          if(typeof fun === "function")
+          //a value received before the acknowledgement of the last local edit is older than the local value
+          var pending = editSeqs[attrId] !== undefined && editSeqs[attrId] > ackedSeq;
+          if(typeof fun === "function" && !pending)
           {
             var newValue = paramUpdate["value"];
             setters[attrId](newValue);
@@ -405,6 +641,10 @@ var a = function(){
           //change state of the specified attribute
         }
       }
+      else if (message.type == "ack")
+      {
+        ackedSeq = Math.max(ackedSeq, message.seq);
+      }
       else
       {
       }
@@ -412,7 +652,8 @@ var a = function(){
     
     ws.onclose = function()
     {
-      alert("webscocket connection is closed");
+      console.log("websocket connection is closed, reconnecting");
+      setTimeout(connect, 1000);
     }
      
   }
@@ -420,7 +661,8 @@ var a = function(){
   {
     alert("Websockets are not available in this browser.");
   }
-}()
+}
+connect();
 
 //ReactDOM.render(<Generator json={jsonTest}/>,document.getElementById('example'));
 
@@ -0,0 +1,47 @@
+# Generates a C++ source file containing the files of the web interface as static byte arrays,
+# so that the library can serve them without reading the disk. Run in script mode:
+#
+#  cmake -DASSETS_ROOT=<directory> -DASSETS_FILES=<file1>,<file2> -DASSETS_OUTPUT=<file.cpp> -P EmbedAssets.cmake
+#
+#  ASSETS_ROOT - directory containing the files
+#  ASSETS_FILES - comma separated paths of the files relative to ASSETS_ROOT, also used as their http resource
+#  ASSETS_OUTPUT - generated source file
+
+string(REPLACE "," ";" ASSETS_FILES "${ASSETS_FILES}")
+
+set(declarations "")
+set(entries "")
+set(index 0)
+
+foreach(asset ${ASSETS_FILES})
+    file(READ "${ASSETS_ROOT}/${asset}" content HEX)
+    string(LENGTH "${content}" hexLength)
+    math(EXPR size "${hexLength} / 2")
+
+    # 16 bytes per line
+    string(REGEX REPLACE "([0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f][0-9a-f])" "\\1\n" content "${content}")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," content "${content}")
+
+    set(declarations "${declarations}static const unsigned char asset${index}[] = {\n${content}0x00\n};\n\n")
+    set(entries "${entries}    {\"${asset}\", asset${index}, ${size}},\n")
+    math(EXPR index "${index} + 1")
+endforeach()
+
+file(WRITE "${ASSETS_OUTPUT}.tmp"
+"// generated by cmake/EmbedAssets.cmake from ${ASSETS_ROOT}, do not edit
+
+#include <InstantInterface/EmbeddedAssets.h>
+
+namespace InstantInterface {
+
+${declarations}const EmbeddedAsset embeddedAssets[] = {
+${entries}};
+
+const size_t embeddedAssetCount = ${index};
+
+}
+")
+
+# the file is only replaced when its content changes, so that the library is not rebuilt for nothing
+execute_process(COMMAND ${CMAKE_COMMAND} -E copy_if_different "${ASSETS_OUTPUT}.tmp" "${ASSETS_OUTPUT}")
+file(REMOVE "${ASSETS_OUTPUT}.tmp")
@@ -0,0 +1,296 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#include "AssetCache.h"
+#include "EmbeddedAssets.h"
+
+#include <boost/filesystem.hpp>
+#include <zlib.h>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace fs = boost::filesystem;
+
+namespace InstantInterface {
+
+AssetCache::AssetCache():
+    refreshInterval(0)
+{}
+
+size_t AssetCache::load(const std::string &r)
+{
+    std::map<std::string, std::shared_ptr<const Asset> > loaded;
+
+    boost::system::error_code ec;
+    for(fs::recursive_directory_iterator it(r, ec), end; !ec && it != end; it.increment(ec))
+    {
+        if(!fs::is_regular_file(it->status()))
+        {
+            continue;
+        }
+
+        std::string path = it->path().generic_string();
+        std::string key = path.substr(fs::path(r).generic_string().size());
+        if(!key.empty() && key[0] == '/')
+        {
+            key.erase(0, 1);
+        }
+
+        if(auto asset = loadFile(path))
+        {
+            loaded[key] = asset;
+        }
+    }
+
+    if(ec)
+    {
+        std::cout<<"InstantInterface::AssetCache::load(), couldn't read the directory "<<r<<": "<<ec.message()<<std::endl;
+    }
+
+    std::lock_guard<std::mutex> lock(assetsMutex);
+    root = r;
+    if(!root.empty() && root.back() != '/' && root.back() != '\\')
+    {
+        root.push_back('/');
+    }
+    assets.swap(loaded);
+    lastChecks.clear();
+    return assets.size();
+}
+
+size_t AssetCache::loadEmbedded()
+{
+    std::map<std::string, std::shared_ptr<const Asset> > loaded;
+#ifdef INSTANTINTERFACE_EMBEDDED_ASSETS
+    for(size_t i = 0; i<embeddedAssetCount; i++)
+    {
+        const EmbeddedAsset& embedded = embeddedAssets[i];
+        loaded[embedded.path] = makeAsset(embedded.path, std::string((const char*)embedded.data, embedded.size), 0);
+    }
+#endif
+
+    std::lock_guard<std::mutex> lock(assetsMutex);
+    //no root, so nothing is read from disk
+    root.clear();
+    assets.swap(loaded);
+    lastChecks.clear();
+    return assets.size();
+}
+
+bool AssetCache::hasEmbeddedAssets()
+{
+#ifdef INSTANTINTERFACE_EMBEDDED_ASSETS
+    return embeddedAssetCount > 0;
+#else
+    return false;
+#endif
+}
+
+void AssetCache::setRefreshInterval(std::chrono::milliseconds interval)
+{
+    std::lock_guard<std::mutex> lock(assetsMutex);
+    refreshInterval = interval;
+}
+
+std::shared_ptr<const Asset> AssetCache::find(const std::string &resource)
+{
+    std::string key = resource.substr(0, resource.find_first_of("?#"));
+    while(!key.empty() && key[0] == '/')
+    {
+        key.erase(0, 1);
+    }
+    if(key.empty() || key.back() == '/')
+    {
+        key += "index.html";
+    }
+
+    std::shared_ptr<const Asset> asset;
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(assetsMutex);
+        auto it = assets.find(key);
+        if(it != assets.end())
+        {
+            asset = it->second;
+        }
+
+        //the files outside of the root directory are never served
+        if(refreshInterval.count() == 0 || root.empty() || key.find("..") != std::string::npos)
+        {
+            return asset;
+        }
+
+        //the other requests of this path won't check it again before the next interval
+        auto now = std::chrono::steady_clock::now();
+        auto lastCheck = lastChecks.find(key);
+        if(lastCheck != lastChecks.end() && now - lastCheck->second < refreshInterval)
+        {
+            return asset;
+        }
+        lastChecks[key] = now;
+        path = root + key;
+    }
+
+    boost::system::error_code ec;
+    std::time_t modificationTime = fs::last_write_time(path, ec);
+    if(ec || !fs::is_regular_file(path, ec))
+    {
+        return asset;
+    }
+    uintmax_t size = fs::file_size(path, ec);
+    if(asset && asset->modificationTime == modificationTime && asset->fileSize == size)
+    {
+        return asset;
+    }
+
+    if(auto reloaded = loadFile(path))
+    {
+        std::lock_guard<std::mutex> lock(assetsMutex);
+        assets[key] = reloaded;
+        asset = reloaded;
+    }
+    return asset;
+}
+
+std::shared_ptr<const Asset> AssetCache::loadFile(const std::string &path)
+{
+    boost::system::error_code ec;
+    std::time_t modificationTime = fs::last_write_time(path, ec);
+
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if(!file)
+    {
+        std::cout<<"InstantInterface::AssetCache, couldn't read the file "<<path<<std::endl;
+        return nullptr;
+    }
+
+    std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return makeAsset(path, std::move(data), modificationTime);
+}
+
+std::shared_ptr<Asset> AssetCache::makeAsset(const std::string &path, std::string data, std::time_t modificationTime)
+{
+    auto asset = std::make_shared<Asset>();
+    asset->body = std::move(data);
+    asset->contentType = getContentType(path);
+    asset->modificationTime = modificationTime;
+    asset->fileSize = asset->body.size();
+
+    //the compressed variants are only kept when they are worth it
+    if(!compress(asset->body, asset->gzipBody, true) || asset->gzipBody.size() >= asset->body.size())
+    {
+        asset->gzipBody.clear();
+    }
+    if(!compress(asset->body, asset->deflateBody, false) || asset->deflateBody.size() >= asset->body.size())
+    {
+        asset->deflateBody.clear();
+    }
+
+    //FNV-1a hash of the content
+    uint64_t hash = 14695981039346656037ULL;
+    for(unsigned char c: asset->body)
+    {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    std::stringstream etag;
+    etag<<'"'<<std::hex<<hash<<'-'<<asset->body.size()<<'"';
+    asset->etag = etag.str();
+
+    char date[64];
+    std::tm* tm = modificationTime > 0 ? std::gmtime(&modificationTime) : nullptr;
+    if(tm && std::strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", tm) > 0)
+    {
+        asset->lastModified = date;
+    }
+
+    return asset;
+}
+
+std::string AssetCache::getContentType(const std::string &path)
+{
+    static const std::map<std::string, std::string> types = {
+        {"html", "text/html; charset=utf-8"},
+        {"htm", "text/html; charset=utf-8"},
+        {"css", "text/css; charset=utf-8"},
+        {"js", "application/javascript; charset=utf-8"},
+        {"json", "application/json"},
+        {"map", "application/json"},
+        {"svg", "image/svg+xml"},
+        {"png", "image/png"},
+        {"jpg", "image/jpeg"},
+        {"jpeg", "image/jpeg"},
+        {"gif", "image/gif"},
+        {"ico", "image/x-icon"},
+        {"woff", "font/woff"},
+        {"woff2", "font/woff2"},
+        {"ttf", "font/ttf"},
+        {"txt", "text/plain; charset=utf-8"}
+    };
+
+    size_t dot = path.find_last_of('.');
+    size_t slash = path.find_last_of("/\\");
+    if(dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+        return "application/octet-stream";
+    }
+
+    auto type = types.find(path.substr(dot+1));
+    return type == types.end() ? "application/octet-stream" : type->second;
+}
+
+bool AssetCache::compress(const std::string &data, std::string &output, bool gzip)
+{
+    z_stream stream = z_stream();
+    //15 bits window, +16 for the gzip header and trailer instead of the zlib ones
+    if(deflateInit2(&stream, Z_BEST_COMPRESSION, Z_DEFLATED, gzip ? 15+16 : 15, 9, Z_DEFAULT_STRATEGY) != Z_OK)
+    {
+        return false;
+    }
+
+    output.resize(deflateBound(&stream, data.size()));
+    stream.next_in = (Bytef*)data.data();
+    stream.avail_in = data.size();
+    stream.next_out = (Bytef*)&output[0];
+    stream.avail_out = output.size();
+
+    int result = deflate(&stream, Z_FINISH);
+    output.resize(stream.total_out);
+    deflateEnd(&stream);
+    return result == Z_STREAM_END;
+}
+
+}
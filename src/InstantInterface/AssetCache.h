@@ -0,0 +1,139 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <ctime>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace InstantInterface {
+
+/**
+ * @brief file of the web interface kept in memory, with its compressed variants and its cache validators
+ */
+struct Asset
+{
+    std::string body;
+    // gzip and zlib (http "deflate") encodings of body, empty if the compression doesn't reduce the size
+    std::string gzipBody;
+    std::string deflateBody;
+    std::string contentType;
+    // strong validator computed from the content
+    std::string etag;
+    // http date of the last modification of the file
+    std::string lastModified;
+
+    // state of the file when it was loaded, used for detecting changes on disk
+    std::time_t modificationTime;
+    uintmax_t fileSize;
+};
+
+/**
+ * @brief The AssetCache class loads all the files of a directory into memory once, so that the http requests are served
+ * without reading the disk. The compressed variants are computed at loading time.
+ * The lookups are thread-safe, the assets are shared and never modified once loaded.
+ */
+class AssetCache
+{
+public:
+    AssetCache();
+
+    /**
+     * @brief loads all the files contained in \p root and its subdirectories, replacing the previous content of the cache
+     * @param root path of the directory, ending with a directory separator
+     * @return the number of loaded files
+     */
+    size_t load(const std::string& root);
+
+    /**
+     * @brief loads the files compiled into the library (see the CMake option INSTANTINTERFACE_EMBED_WEBAPP),
+     * replacing the previous content of the cache. The reloading from disk doesn't apply to them.
+     * @return the number of loaded files
+     */
+    size_t loadEmbedded();
+
+    /**
+     * @brief returns true if the files of the web interface have been compiled into the library
+     */
+    static bool hasEmbeddedAssets();
+
+    /**
+     * @brief enables the reloading of the files that have changed on disk. Each file is checked at most once per \p interval
+     * when it is requested. The files added to the directory after load() are found as well.
+     * @param interval minimum time between two checks of the same file, 0 disables the reloading (default)
+     */
+    void setRefreshInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief returns the asset corresponding to the http resource \p resource ("/" is the same as "/index.html"),
+     * or nullptr if there is no such file
+     */
+    std::shared_ptr<const Asset> find(const std::string& resource);
+
+    /**
+     * @brief returns the mime type associated with the extension of \p path
+     */
+    static std::string getContentType(const std::string& path);
+
+    /**
+     * @brief compresses \p data with zlib, in gzip format if \p gzip is true, in zlib format otherwise
+     * @return false if the compression failed
+     */
+    static bool compress(const std::string& data, std::string& output, bool gzip);
+
+    /**
+     * @brief builds the asset from the content \p data of the file \p path
+     * @param modificationTime time of the last modification of the file, 0 if unknown
+     */
+    static std::shared_ptr<Asset> makeAsset(const std::string& path, std::string data, std::time_t modificationTime);
+
+private:
+    std::shared_ptr<const Asset> loadFile(const std::string& path);
+
+    std::string root;
+    std::chrono::milliseconds refreshInterval;
+
+    // assets indexed by their path relative to root, with '/' as separator
+    std::map<std::string, std::shared_ptr<const Asset> > assets;
+    // time of the last check on disk of each requested path, when the reloading is enabled
+    std::map<std::string, std::chrono::steady_clock::time_point> lastChecks;
+    std::mutex assetsMutex;
+};
+
+}
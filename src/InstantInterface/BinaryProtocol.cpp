@@ -0,0 +1,207 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+#include "BinaryProtocol.h"
+
+#include <cmath>
+#include <cstring>
+
+namespace InstantInterface {
+
+namespace BinaryProtocol {
+
+const char* const subprotocol = "instantinterface.binary";
+
+uint16_t quantize(float value, float minVal, float maxVal)
+{
+    if(!(maxVal > minVal))
+    {
+        return 0;
+    }
+    float normalized = (value - minVal) / (maxVal - minVal);
+    if(!(normalized > 0.0f))
+    {
+        return 0;
+    }
+    if(normalized >= 1.0f)
+    {
+        return 65535;
+    }
+    return (uint16_t)std::lround(normalized * 65535.0f);
+}
+
+float dequantize(uint16_t value, float minVal, float maxVal)
+{
+    return minVal + (maxVal - minVal) * (value / 65535.0f);
+}
+
+}
+
+BinaryWriter::BinaryWriter(std::string &buffer):
+    out(buffer)
+{}
+
+void BinaryWriter::uint8(uint8_t v)
+{
+    out.push_back((char)v);
+}
+
+void BinaryWriter::uint16(uint16_t v)
+{
+    out.push_back((char)(v & 0xff));
+    out.push_back((char)(v >> 8));
+}
+
+void BinaryWriter::uint32(uint32_t v)
+{
+    for(int i = 0; i<4; i++)
+    {
+        out.push_back((char)((v >> (8*i)) & 0xff));
+    }
+}
+
+void BinaryWriter::float32(float v)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    uint32(bits);
+}
+
+void BinaryWriter::float64(double v)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    for(int i = 0; i<8; i++)
+    {
+        out.push_back((char)((bits >> (8*i)) & 0xff));
+    }
+}
+
+void BinaryWriter::string(const std::string &v)
+{
+    uint32(v.size());
+    out.append(v);
+}
+
+void BinaryWriter::record(size_t handle, BinaryProtocol::ValueTag tag)
+{
+    uint32(handle);
+    uint8(tag);
+}
+
+BinaryReader::BinaryReader(const std::string &payload):
+    in(payload),
+    position(0)
+{}
+
+bool BinaryReader::uint8(uint8_t &v)
+{
+    if(in.size() - position < 1)
+    {
+        return false;
+    }
+    v = (uint8_t)in[position++];
+    return true;
+}
+
+bool BinaryReader::uint16(uint16_t &v)
+{
+    if(in.size() - position < 2)
+    {
+        return false;
+    }
+    v = (uint16_t)((uint8_t)in[position] | ((uint8_t)in[position+1] << 8));
+    position += 2;
+    return true;
+}
+
+bool BinaryReader::uint32(uint32_t &v)
+{
+    if(in.size() - position < 4)
+    {
+        return false;
+    }
+    v = 0;
+    for(int i = 0; i<4; i++)
+    {
+        v |= (uint32_t)(uint8_t)in[position+i] << (8*i);
+    }
+    position += 4;
+    return true;
+}
+
+bool BinaryReader::float32(float &v)
+{
+    uint32_t bits;
+    if(!uint32(bits))
+    {
+        return false;
+    }
+    std::memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+bool BinaryReader::float64(double &v)
+{
+    if(in.size() - position < 8)
+    {
+        return false;
+    }
+    uint64_t bits = 0;
+    for(int i = 0; i<8; i++)
+    {
+        bits |= (uint64_t)(uint8_t)in[position+i] << (8*i);
+    }
+    position += 8;
+    std::memcpy(&v, &bits, sizeof(v));
+    return true;
+}
+
+bool BinaryReader::string(std::string &v)
+{
+    uint32_t length;
+    if(!uint32(length) || in.size() - position < length)
+    {
+        return false;
+    }
+    v.assign(in, position, length);
+    position += length;
+    return true;
+}
+
+bool BinaryReader::atEnd() const
+{
+    return position >= in.size();
+}
+
+}
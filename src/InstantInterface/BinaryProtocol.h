@@ -0,0 +1,140 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace InstantInterface {
+
+/**
+ * @brief The binary protocol is an alternative to the json update messages, negotiated with the websocket subprotocol
+ * BinaryProtocol::subprotocol. The structure is still sent in json, with the handle of each element, and the values are
+ * sent in binary frames made of a message type followed by packed records. All the numbers are little endian.
+ *
+ * update message:  MESSAGE_UPDATE, then for each value: handle (uint32), tag (uint8), value
+ *   TAG_BOOL: uint8, TAG_INT: int32, TAG_FLOAT: float32, TAG_DOUBLE: float64, TAG_STRING: length (uint32) + utf8 bytes,
+ *   TAG_QUANTIZED: uint16, float value mapped linearly from [min, max] of the attribute to [0, 65535] (server to client only)
+ * action message:  MESSAGE_ACTION, handle (uint32)
+ */
+namespace BinaryProtocol {
+
+// name of the websocket subprotocol selecting the binary value frames
+extern const char* const subprotocol;
+
+enum MessageType
+{
+    MESSAGE_UPDATE = 1,
+    MESSAGE_ACTION = 2
+};
+
+enum ValueTag
+{
+    TAG_BOOL = 'b',
+    TAG_INT = 'i',
+    TAG_FLOAT = 'f',
+    TAG_DOUBLE = 'd',
+    TAG_STRING = 's',
+    TAG_QUANTIZED = 'q'
+};
+
+/**
+ * @brief quantizes \p value on 16 bits in the range [\p minVal, \p maxVal]
+ */
+uint16_t quantize(float value, float minVal, float maxVal);
+
+/**
+ * @brief inverse of quantize()
+ */
+float dequantize(uint16_t value, float minVal, float maxVal);
+
+}
+
+/**
+ * @brief The BinaryWriter class appends the records of the binary protocol at the end of a string buffer,
+ * like JsonWriter does for json.
+ */
+class BinaryWriter
+{
+public:
+    /**
+     * @brief constructor
+     * @param buffer string at the end of which the records are written
+     */
+    BinaryWriter(std::string& buffer);
+
+    void uint8(uint8_t v);
+    void uint16(uint16_t v);
+    void uint32(uint32_t v);
+    void float32(float v);
+    void float64(double v);
+    void string(const std::string& v);
+
+    /**
+     * @brief writes the handle and the tag of a value record, to be followed by the value
+     */
+    void record(size_t handle, BinaryProtocol::ValueTag tag);
+
+private:
+    std::string& out;
+};
+
+/**
+ * @brief The BinaryReader class reads the records of the binary protocol from a received payload.
+ * Each read fails (returns false) instead of reading past the end of the payload.
+ */
+class BinaryReader
+{
+public:
+    BinaryReader(const std::string& payload);
+
+    bool uint8(uint8_t& v);
+    bool uint16(uint16_t& v);
+    bool uint32(uint32_t& v);
+    bool float32(float& v);
+    bool float64(double& v);
+    bool string(std::string& v);
+
+    /**
+     * @brief returns true if the whole payload has been read
+     */
+    bool atEnd() const;
+
+private:
+    const std::string& in;
+    size_t position;
+};
+
+}
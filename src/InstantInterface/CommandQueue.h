@@ -0,0 +1,187 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace InstantInterface {
+
+/**
+ * @brief The CommandQueue class is a bounded lock-free queue with several producers and a single consumer.
+ * The slots are allocated once in the constructor: a pushed value is assigned to the value of its slot and a popped value is swapped out of it,
+ * so that the memory of the values (for instance the buffer of a std::string) is recycled instead of being allocated for each command.
+ * When the queue is full, push() fails immediately instead of waiting for the consumer, and the overflow is counted.
+ *
+ * Each slot holds a sequence number telling whether it is ready to be written (sequence == position) or to be read (sequence == position+1).
+ */
+template<typename T>
+class CommandQueue
+{
+public:
+
+    /**
+     * @brief constructor
+     * @param capacity maximum number of values in the queue, rounded up to a power of two
+     */
+    CommandQueue(size_t capacity = 1024) :
+        mask(roundCapacity(capacity)-1),
+        slots(new Slot[mask+1]),
+        overflows(0),
+        writePosition(0),
+        readPosition(0)
+    {
+        for(size_t i = 0; i<=mask; i++)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    CommandQueue(const CommandQueue&) = delete;
+    CommandQueue& operator=(const CommandQueue&) = delete;
+
+    /**
+     * @brief adds a copy of \p value at the end of the queue. Can be called from any thread.
+     * @return false if the queue is full, in which case \p value is dropped
+     */
+    bool push(const T& value)
+    {
+        size_t position = writePosition.load(std::memory_order_relaxed);
+        Slot* slot;
+        for(;;)
+        {
+            slot = &slots[position & mask];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)sequence - (intptr_t)position;
+            if(diff == 0)
+            {
+                //the slot is free, try to reserve it
+                if(writePosition.compare_exchange_weak(position, position+1, std::memory_order_relaxed))
+                {
+                    break;
+                }
+            }
+            else if(diff < 0)
+            {
+                //the slot still contains the value pushed one lap before
+                overflows.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                //another producer took the slot
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = value;
+        slot->sequence.store(position+1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief moves the first value of the queue into \p value. Must be called from a single thread at a time.
+     * @return false if the queue is empty
+     */
+    bool pop(T& value)
+    {
+        size_t position = readPosition.load(std::memory_order_relaxed);
+        Slot& slot = slots[position & mask];
+        if(slot.sequence.load(std::memory_order_acquire) != position+1)
+        {
+            return false;
+        }
+
+        using std::swap;
+        swap(value, slot.value);
+        readPosition.store(position+1, std::memory_order_relaxed);
+        //frees the slot for the producer of the next lap
+        slot.sequence.store(position+mask+1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief returns the number of values in the queue (approximate when the queue is used concurrently)
+     */
+    size_t size() const
+    {
+        size_t read = readPosition.load(std::memory_order_relaxed);
+        size_t write = writePosition.load(std::memory_order_relaxed);
+        return write > read ? write - read : 0;
+    }
+
+    size_t capacity() const
+    {
+        return mask+1;
+    }
+
+    /**
+     * @brief returns the number of values dropped by push() because the queue was full
+     */
+    uint64_t getOverflowCount() const
+    {
+        return overflows.load(std::memory_order_relaxed);
+    }
+
+private:
+
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    static size_t roundCapacity(size_t capacity)
+    {
+        size_t rounded = 2;
+        while(rounded < capacity)
+        {
+            rounded *= 2;
+        }
+        return rounded;
+    }
+
+    const size_t mask;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<uint64_t> overflows;
+
+    //the producers and the consumer work on different cache lines
+    alignas(64) std::atomic<size_t> writePosition;
+    alignas(64) std::atomic<size_t> readPosition;
+};
+
+}
@@ -33,10 +33,14 @@
 //M*/
 
 #include "InterfaceManager.h"
+#include "JsonWriter.h"
+#include "BinaryProtocol.h"
 #include <json/json.h>
 #include <vector>
 #include <map>
 #include <iostream>
+#include <deque>
+#include <algorithm>
 
 using namespace std;
 
@@ -57,7 +61,7 @@ namespace InstantInterface {
  */
 class JsonNode{
 public:
-    virtual Json::Value getJsonStructure() = 0;
+    virtual void writeJsonStructure(JsonWriter& writer, bool withValues) = 0;
 };
 
 /**
@@ -66,10 +70,26 @@ public:
 class JsonGroupBase : public JsonNode
 {
 public:
+    JsonGroupBase(const std::string& p, size_t i);
     void add(std::shared_ptr<JsonNode> part);
 
+    /**
+     * @brief path of the group, made of the escaped names of the groups from the root to this group, separated by '/'
+     * (see InterfaceManager::getGroupPaths())
+     */
+    const std::string& getPath() const;
+
+    /**
+     * @brief index of the group in the list of groups of the interface (0 for the root)
+     */
+    size_t getIndex() const;
+
 protected:
     std::vector<std::shared_ptr<JsonNode> > tree;
+
+private:
+    std::string path;
+    size_t index;
 };
 
 /**
@@ -78,8 +98,9 @@ protected:
 class JsonTreeRoot : public JsonGroupBase
 {
 public:
+    JsonTreeRoot();
     void clear();
-    Json::Value getJsonStructure();
+    void writeJsonStructure(JsonWriter& writer, bool withValues);
 };
 
 /**
@@ -88,9 +109,9 @@ public:
 class JsonGroup: public JsonGroupBase
 {
 public:
-    JsonGroup(std::string nn);
+    JsonGroup(std::string nn, const std::string& path, size_t index);
     std::string getName();
-    Json::Value getJsonStructure();
+    void writeJsonStructure(JsonWriter& writer, bool withValues);
 
 private:
     std::string name;
@@ -102,12 +123,49 @@ private:
 class JsonElement: public JsonNode
 {
 public:
-    JsonElement() : name("empty_name"), id("empty_id"){}
+    JsonElement() : name("empty_name"), id("empty_id"), version(0), group(0), handle(0){}
     virtual std::string getValueType() = 0;
     virtual void setFromJson(Json::Value val) = 0;
     virtual std::string getValueAsString() = 0;
-    virtual Json::Value getJsonValue() = 0;
-    virtual Json::Value getJsonStructure() = 0;
+
+    /**
+     * @brief returns the type of the value of the element, TYPE_UNDEFINED if the element has no value
+     */
+    virtual TypeValue getTypeValue() const = 0;
+
+    /**
+     * @brief sets the value contained in \p update, whose type has already been checked
+     */
+    virtual void applyUpdate(const ElementUpdate& update) = 0;
+    virtual void writeJsonStructure(JsonWriter& writer, bool withValues) = 0;
+
+    /**
+     * @brief returns false if the element has no value (for instance an action)
+     */
+    virtual bool hasValue() const {return true;}
+
+    /**
+     * @brief writes the current value of the element
+     */
+    virtual void writeJsonValue(JsonWriter& writer) = 0;
+
+    /**
+     * @brief writes the current value of the element as a record of the binary protocol (nothing if the element has no value)
+     * @param quantize if true, a float with a min and a max is quantized on 16 bits
+     */
+    virtual void writeBinaryValue(BinaryWriter& /*writer*/, bool /*quantize*/) {}
+
+    /**
+     * @brief reads the current value of the element and compares it to the value read at the previous call
+     * @param buffer reusable buffer in which the current value is serialized
+     * @return true if the value has changed since the previous call
+     */
+    virtual bool pollValueChange(std::string& /*buffer*/) {return false;}
+
+    /**
+     * @brief returns the value read at the last call of pollValueChange(), serialized in json
+     */
+    virtual const std::string& getLastValueJson() const;
 
     const std::string& getName() const;
     void setName(const std::string& n);
@@ -115,9 +173,21 @@ public:
     const std::string& getId() const;
     void setId(const std::string& i);
 
+    uint64_t getVersion() const;
+    void setVersion(uint64_t v);
+
+    size_t getGroup() const;
+    void setGroup(size_t g);
+
+    size_t getHandle() const;
+    void setHandle(size_t h);
+
 private:
     std::string name;
     std::string id;
+    uint64_t version;
+    size_t group;
+    size_t handle;
 };
 
 /**
@@ -134,9 +204,15 @@ public:
 
     std::string getValueAsString();
 
-    Json::Value getJsonValue();
+    TypeValue getTypeValue() const;
+
+    void applyUpdate(const ElementUpdate& update);
+
+    bool hasValue() const;
+
+    void writeJsonValue(JsonWriter& writer);
 
-    Json::Value getJsonStructure();
+    void writeJsonStructure(JsonWriter& writer, bool withValues);
 
     virtual void applyAction();
 
@@ -158,13 +234,19 @@ public:
     virtual void set(ParamType v);
     virtual ParamType get();
     virtual std::string getValueAsString();
-    Json::Value getJsonValue();
-    Json::Value getJsonStructure();
+    TypeValue getTypeValue() const;
+    void applyUpdate(const ElementUpdate& update);
+    void writeJsonValue(JsonWriter& writer);
+    void writeBinaryValue(BinaryWriter& writer, bool quantize);
+    void writeJsonStructure(JsonWriter& writer, bool withValues);
     std::string getValueType();
     bool getMinMax(ParamType& minVal, ParamType& maxVal);
+    bool pollValueChange(std::string& buffer);
+    const std::string& getLastValueJson() const;
 
 private:
     std::weak_ptr<AttributeT<ParamType> > _attr;
+    std::string lastValueJson;
 };
 
 
@@ -190,6 +272,46 @@ namespace factory{
 
 typedef std::map<std::string,std::shared_ptr<JsonElement> > JsonElementMap;
 
+/**
+ * @brief data shared by all the InterfaceManager instances that manage the same interface
+ */
+struct InterfaceRegistry
+{
+    InterfaceRegistry() : groupPaths(1, ""), stateVersion(0), handleGeneration(0), structureRevision(0), journalCapacity(1024) {}
+
+    /**
+     * @brief records the insertion of \p node in the group \p groupPath
+     */
+    void journalInsert(const std::string& groupPath, std::shared_ptr<JsonNode> node);
+
+    JsonElementMap attributes;
+    // elements of the interface indexed by their handle
+    std::vector<std::shared_ptr<JsonElement> > elements;
+    // paths of the groups of the interface, indexed by JsonGroupBase::getIndex()
+    std::vector<std::string> groupPaths;
+    uint64_t stateVersion;
+    uint64_t handleGeneration;
+    // reusable buffer used when polling the values
+    std::string valueBuffer;
+
+    /**
+     * @brief structural edit recorded in the journal
+     */
+    struct StructureEdit
+    {
+        // revision of the structure after the edit
+        uint64_t revision;
+        std::string groupPath;
+        std::shared_ptr<JsonNode> node;
+    };
+
+    // number of structural edits since the creation of the interface
+    uint64_t structureRevision;
+    // last edits, the oldest ones are dropped beyond journalCapacity
+    std::deque<StructureEdit> journal;
+    size_t journalCapacity;
+};
+
 
 /***
  *
@@ -215,11 +337,11 @@ class InterfaceManager::InterfaceImpl
 public:
     InterfaceImpl(){}
     ~InterfaceImpl(){}
-    Json::Value getJsonStructure();
     void addInteractionElement(const std::string &name, std::shared_ptr<JsonElement> ie);
     virtual std::shared_ptr<JsonGroupBase> getTree() = 0;
-    virtual JsonElementMap& getMap() = 0;
+    virtual InterfaceRegistry& getRegistry() = 0;
     virtual void clear() = 0;
+    JsonElementMap& getMap();
 private:
 
 };
@@ -234,13 +356,13 @@ public:
 
     InterfaceRootImpl();
     ~InterfaceRootImpl(){}
-    JsonElementMap& getMap();
+    InterfaceRegistry& getRegistry();
     std::shared_ptr<JsonGroupBase> getTree();
     void clear();
 
 private:
     std::shared_ptr<JsonTreeRoot> structure;
-    JsonElementMap attributes;
+    InterfaceRegistry registry;
 };
 
 /**
@@ -250,15 +372,15 @@ class InterfaceManager::InterfaceRefImpl: public InterfaceManager::InterfaceImpl
 {
 public:
 
-    InterfaceRefImpl(std::shared_ptr<JsonGroupBase> s, JsonElementMap& m);
+    InterfaceRefImpl(std::shared_ptr<JsonGroupBase> s, InterfaceRegistry& r);
     ~InterfaceRefImpl(){}
-    JsonElementMap& getMap();
+    InterfaceRegistry& getRegistry();
     std::shared_ptr<JsonGroupBase> getTree();
     void clear();
 
 private:
     std::shared_ptr<JsonGroupBase> structure;
-    JsonElementMap& attributes;
+    InterfaceRegistry& registry;
 };
 
 
@@ -281,7 +403,7 @@ InterfaceManager::InterfaceManager() : impl(new InterfaceRootImpl())
 {}
 
 InterfaceManager::InterfaceManager(const InterfaceManager &a):
-    impl(new InterfaceRefImpl(a.impl->getTree(), a.impl->getMap()))
+    impl(new InterfaceRefImpl(a.impl->getTree(), a.impl->getRegistry()))
 {}
 
 InterfaceManager::~InterfaceManager()
@@ -324,21 +446,65 @@ InterfaceManager &InterfaceManager::addInteractionElement<bool>(const std::strin
 }
 
 
+/**
+ * @brief escapes the characters of a group name that have a meaning in the paths ('/' separates the groups, '#' numbers
+ * the groups of the same name)
+ */
+static std::string escapePathSegment(const std::string& name)
+{
+    std::string segment;
+    for(char c: name)
+    {
+        switch(c)
+        {
+        case '%': segment += "%25"; break;
+        case '/': segment += "%2F"; break;
+        case '#': segment += "%23"; break;
+        default: segment += c;
+        }
+    }
+    return segment;
+}
+
 InterfaceManager InterfaceManager::createGroup(const std::string &name)
 {
-    auto group = std::make_shared<JsonGroup>(name);
+    auto& registry = impl->getRegistry();
+    const std::string& parentPath = impl->getTree()->getPath();
+    std::string segment = escapePathSegment(name);
+    std::string path = parentPath.empty() ? segment : parentPath + "/" + segment;
+    //a group with the same name as one of its siblings is numbered, so that a path identifies a single group
+    const std::string base = path;
+    for(unsigned int n = 2; std::find(registry.groupPaths.begin(), registry.groupPaths.end(), path) != registry.groupPaths.end(); n++)
+    {
+        path = base + "#" + std::to_string(n);
+    }
+
+    auto group = std::make_shared<JsonGroup>(name, path, registry.groupPaths.size());
+    registry.groupPaths.push_back(path);
     impl->getTree()->add(group);
-    auto pImpl = std::unique_ptr<InterfaceImpl>(new InterfaceRefImpl(group,impl->getMap()));
+    registry.journalInsert(parentPath, group);
+    auto pImpl = std::unique_ptr<InterfaceImpl>(new InterfaceRefImpl(group,registry));
     return InterfaceManager(std::move(pImpl));
 }
 
 
 std::string InterfaceManager::getStructureJsonString() const
 {
-    Json::Value interfaceMessage;
-    interfaceMessage["type"] = "interface";
-    interfaceMessage["content"] = impl->getJsonStructure();
-    return interfaceMessage.toStyledString();
+    std::string buffer;
+    writeStructureJson(buffer);
+    return buffer;
+}
+
+void InterfaceManager::writeStructureJson(string &buffer, bool withValues) const
+{
+    buffer.clear();
+    JsonWriter writer(buffer);
+    writer.beginObject();
+    writer.key("type");
+    writer.value("interface");
+    writer.key("content");
+    impl->getTree()->writeJsonStructure(writer, withValues);
+    writer.endObject();
 }
 
 void InterfaceManager::updateInterfaceElement(const std::string &name, const Json::Value &val)
@@ -354,18 +520,344 @@ void InterfaceManager::updateInterfaceElement(const std::string &name, const Jso
     }
 }
 
+void InterfaceRegistry::journalInsert(const string &groupPath, std::shared_ptr<JsonNode> node)
+{
+    structureRevision++;
+    if(journalCapacity == 0)
+    {
+        return;
+    }
+    if(journal.size() >= journalCapacity)
+    {
+        journal.pop_front();
+    }
+    journal.push_back(StructureEdit{structureRevision, groupPath, node});
+}
+
+uint64_t InterfaceManager::getStructureRevision() const
+{
+    return impl->getRegistry().structureRevision;
+}
+
+void InterfaceManager::setStructureJournalCapacity(size_t capacity)
+{
+    auto& registry = impl->getRegistry();
+    registry.journalCapacity = capacity;
+    while(registry.journal.size() > capacity)
+    {
+        registry.journal.pop_front();
+    }
+}
+
+bool InterfaceManager::writeStructurePatchJson(string &buffer, uint64_t since) const
+{
+    const auto& registry = impl->getRegistry();
+    buffer.clear();
+
+    //all the edits made after the revision since must still be in the journal
+    if(since > registry.structureRevision)
+    {
+        return false;
+    }
+    if(since < registry.structureRevision && (registry.journal.empty() || registry.journal.front().revision > since+1))
+    {
+        return false;
+    }
+
+    JsonWriter writer(buffer);
+    writer.beginObject();
+    writer.key("type");
+    writer.value("patch");
+    writer.key("content");
+    writer.beginArray();
+    for(const auto& edit: registry.journal)
+    {
+        if(edit.revision <= since)
+        {
+            continue;
+        }
+        writer.beginObject();
+        writer.key("op");
+        writer.value("insert");
+        writer.key("group");
+        writer.value(edit.groupPath);
+        writer.key("node");
+        if(auto group = std::dynamic_pointer_cast<JsonGroup>(edit.node))
+        {
+            //the content of the group is made of the next edits
+            writer.beginObject();
+            writer.key("type");
+            writer.value("group");
+            writer.key("name");
+            writer.value(group->getName());
+            writer.key("path");
+            writer.value(group->getPath());
+            writer.key("content");
+            writer.beginArray();
+            writer.endArray();
+            writer.endObject();
+        }
+        else
+        {
+            edit.node->writeJsonStructure(writer, true);
+        }
+        writer.endObject();
+    }
+    writer.endArray();
+    writer.endObject();
+    return true;
+}
+
+uint64_t InterfaceManager::getElementHandles(ElementHandleMap &handles) const
+{
+    const auto& elements = impl->getRegistry().elements;
+    handles.clear();
+    for(size_t i = 0; i<elements.size(); i++)
+    {
+        handles[elements[i]->getId()] = ElementHandle{i, elements[i]->getTypeValue()};
+    }
+    return getHandleGeneration();
+}
+
+uint64_t InterfaceManager::getHandleGeneration() const
+{
+    return impl->getRegistry().handleGeneration;
+}
+
+bool InterfaceManager::applyElementUpdate(const ElementUpdate &update)
+{
+    const auto& registry = impl->getRegistry();
+    if(update.handleGeneration != registry.handleGeneration || update.handle >= registry.elements.size())
+    {
+        std::cout<<"The element handle "<<update.handle<<" is not valid anymore."<<std::endl;
+        return false;
+    }
+
+    JsonElement& element = *registry.elements[update.handle];
+    if(element.getTypeValue() != update.type)
+    {
+        std::cout<<"The update of "<<element.getId()<<" has the wrong type."<<std::endl;
+        return false;
+    }
+
+    element.applyUpdate(update);
+    return true;
+}
+
 std::string InterfaceManager::getStateJsonString() const
 {
-    Json::Value state;
-    state["type"] = "update";
-    Json::Value content;
+    std::string buffer;
+    writeStateJson(buffer);
+    return buffer;
+}
+
+void InterfaceManager::writeStateJson(string &buffer) const
+{
+    buffer.clear();
+    JsonWriter writer(buffer);
+    writer.beginObject();
+    writer.key("type");
+    writer.value("update");
+    writer.key("content");
+    writer.beginArray();
+    for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
+    {
+        if(it->second->hasValue())
+        {
+            it->second->writeJsonValue(writer);
+        }
+    }
+    writer.endArray();
+    writer.endObject();
+}
+
+uint64_t InterfaceManager::pollStateChanges()
+{
+    uint64_t& version = impl->getRegistry().stateVersion;
+    std::string& buffer = impl->getRegistry().valueBuffer;
+    bool changed = false;
     for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
     {
-        content.append(it->second->getJsonStructure());
+        if(it->second->pollValueChange(buffer))
+        {
+            //all the changes detected in the same call share the same version
+            if(!changed)
+            {
+                version++;
+                changed = true;
+            }
+            it->second->setVersion(version);
+        }
     }
-    state["content"] = content;
+    return version;
+}
 
-    return state.toStyledString();
+std::string InterfaceManager::getStateDeltaJsonString(uint64_t since) const
+{
+    std::string buffer;
+    writeStateDeltaJson(buffer, since);
+    return buffer;
+}
+
+bool InterfaceManager::writeStateDeltaJson(string &buffer, uint64_t since) const
+{
+    bool changed = false;
+    buffer.clear();
+    JsonWriter writer(buffer);
+    writer.beginObject();
+    writer.key("type");
+    writer.value("update");
+    writer.key("content");
+    writer.beginArray();
+    for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
+    {
+        if(it->second->getVersion() > since)
+        {
+            //the values polled by pollStateChanges() are sent, so that the delta is consistent with the versions
+            writer.beginObject();
+            writer.key("id");
+            writer.value(it->second->getId());
+            writer.key("value");
+            writer.valueRaw(it->second->getLastValueJson());
+            writer.endObject();
+            changed = true;
+        }
+    }
+    writer.endArray();
+    writer.endObject();
+    return changed;
+}
+
+void InterfaceManager::getChangedElements(std::vector<size_t> &handles, uint64_t since) const
+{
+    handles.clear();
+    const auto& elements = impl->getRegistry().elements;
+    for(size_t i = 0; i<elements.size(); i++)
+    {
+        if(elements[i]->getVersion() > since)
+        {
+            handles.push_back(i);
+        }
+    }
+}
+
+const string &InterfaceManager::getPolledValueJson(size_t handle) const
+{
+    static const std::string invalid;
+    const auto& elements = impl->getRegistry().elements;
+    return handle < elements.size() ? elements[handle]->getLastValueJson() : invalid;
+}
+
+std::vector<string> InterfaceManager::getGroupPaths() const
+{
+    return impl->getRegistry().groupPaths;
+}
+
+void InterfaceManager::writeStateJsonByGroup(std::vector<string> &fragments) const
+{
+    const size_t nGroups = impl->getRegistry().groupPaths.size();
+    fragments.resize(nGroups);
+    for(auto& fragment: fragments)
+    {
+        fragment.clear();
+    }
+
+    for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
+    {
+        size_t group = it->second->getGroup();
+        if(!it->second->hasValue() || group >= nGroups)
+        {
+            continue;
+        }
+
+        std::string& fragment = fragments[group];
+        if(!fragment.empty())
+        {
+            fragment.push_back(',');
+        }
+        JsonWriter writer(fragment);
+        it->second->writeJsonValue(writer);
+    }
+}
+
+bool InterfaceManager::writeStateDeltaJsonByGroup(std::vector<string> &fragments, uint64_t since) const
+{
+    const size_t nGroups = impl->getRegistry().groupPaths.size();
+    fragments.resize(nGroups);
+    for(auto& fragment: fragments)
+    {
+        fragment.clear();
+    }
+
+    bool changed = false;
+    for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
+    {
+        size_t group = it->second->getGroup();
+        if(it->second->getVersion() <= since || group >= nGroups)
+        {
+            continue;
+        }
+
+        std::string& fragment = fragments[group];
+        if(!fragment.empty())
+        {
+            fragment.push_back(',');
+        }
+        JsonWriter writer(fragment);
+        writer.beginObject();
+        writer.key("id");
+        writer.value(it->second->getId());
+        writer.key("value");
+        writer.valueRaw(it->second->getLastValueJson());
+        writer.endObject();
+        changed = true;
+    }
+    return changed;
+}
+
+void InterfaceManager::writeStateBinaryByGroup(std::vector<string> &fragments, bool quantize) const
+{
+    const size_t nGroups = impl->getRegistry().groupPaths.size();
+    fragments.resize(nGroups);
+    for(auto& fragment: fragments)
+    {
+        fragment.clear();
+    }
+
+    for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
+    {
+        size_t group = it->second->getGroup();
+        if(group < nGroups)
+        {
+            BinaryWriter writer(fragments[group]);
+            it->second->writeBinaryValue(writer, quantize);
+        }
+    }
+}
+
+bool InterfaceManager::writeStateDeltaBinaryByGroup(std::vector<string> &fragments, uint64_t since, bool quantize) const
+{
+    const size_t nGroups = impl->getRegistry().groupPaths.size();
+    fragments.resize(nGroups);
+    for(auto& fragment: fragments)
+    {
+        fragment.clear();
+    }
+
+    bool changed = false;
+    for(auto it = impl->getMap().begin(); it!=impl->getMap().end(); it++)
+    {
+        size_t group = it->second->getGroup();
+        if(it->second->getVersion() <= since || group >= nGroups)
+        {
+            continue;
+        }
+
+        BinaryWriter writer(fragments[group]);
+        it->second->writeBinaryValue(writer, quantize);
+        changed = true;
+    }
+    return changed;
 }
 
 void InterfaceManager::clear()
@@ -387,7 +879,7 @@ std::string JsonAction::getValueType()
     return "a";
 }
 
-void JsonAction::setFromJson(Json::Value val)
+void JsonAction::setFromJson(Json::Value /*val*/)
 {
     applyAction();
 }
@@ -397,24 +889,45 @@ std::string JsonAction::getValueAsString()
     return "no value";
 }
 
-Json::Value JsonAction::getJsonValue()
+TypeValue JsonAction::getTypeValue() const
 {
-    Json::Value state;
-    state["id"] = getId();
-    state["value"] = Json::Value();
-    return state.toStyledString();
+    return TYPE_UNDEFINED;
 }
 
-Json::Value JsonAction::getJsonStructure()
+void JsonAction::applyUpdate(const ElementUpdate &/*update*/)
 {
-    Json::Value def;
+    applyAction();
+}
 
-    def["type"] = "parameter";
-    def["name"] = getName();
-    def["id"] = getId();
-    def["valueType"] = getValueType();
+bool JsonAction::hasValue() const
+{
+    return false;
+}
 
-    return def;
+void JsonAction::writeJsonValue(JsonWriter &writer)
+{
+    writer.beginObject();
+    writer.key("id");
+    writer.value(getId());
+    writer.key("value");
+    writer.valueNull();
+    writer.endObject();
+}
+
+void JsonAction::writeJsonStructure(JsonWriter &writer, bool /*withValues*/)
+{
+    writer.beginObject();
+    writer.key("type");
+    writer.value("parameter");
+    writer.key("name");
+    writer.value(getName());
+    writer.key("id");
+    writer.value(getId());
+    writer.key("handle");
+    writer.value((int)getHandle());
+    writer.key("valueType");
+    writer.value("a");
+    writer.endObject();
 }
 
 void JsonAction::applyAction()
@@ -430,35 +943,47 @@ JsonAttributeT<ParamType>::JsonAttributeT(std::weak_ptr<AttributeT<ParamType> >
 
 
 template<class T>
-Json::Value JsonAttributeT<T>::getJsonStructure()
+void JsonAttributeT<T>::writeJsonStructure(JsonWriter &writer, bool withValues)
 {
-    Json::Value paramJson;
-
-    paramJson["type"] = "parameter";
-    paramJson["name"] = getName();
-    paramJson["id"] = getId();
-    paramJson["value"] = get();
-    paramJson["valueType"] = getValueType();
+    writer.beginObject();
+    writer.key("type");
+    writer.value("parameter");
+    writer.key("name");
+    writer.value(getName());
+    writer.key("id");
+    writer.value(getId());
+    writer.key("handle");
+    writer.value((int)getHandle());
+    if(withValues)
+    {
+        writer.key("value");
+        writer.value(get());
+    }
+    writer.key("valueType");
+    writer.value(getValueType());
 
     T  minVal, maxVal;
 
     if(getMinMax(minVal,maxVal))
     {
-        paramJson["min"] = minVal;
-        paramJson["max"] = maxVal;
+        writer.key("min");
+        writer.value(minVal);
+        writer.key("max");
+        writer.value(maxVal);
     }
 
-    return paramJson;
+    writer.endObject();
 }
 
 template <class T>
-Json::Value JsonAttributeT<T>::getJsonValue()
+void JsonAttributeT<T>::writeJsonValue(JsonWriter &writer)
 {
-    Json::Value state;
-    state["id"] = getId();
-    state["value"] = get();
-
-    return state;
+    writer.beginObject();
+    writer.key("id");
+    writer.value(getId());
+    writer.key("value");
+    writer.value(get());
+    writer.endObject();
 }
 
 
@@ -495,6 +1020,26 @@ ParamType JsonAttributeT<ParamType>::get()
     return output;
 }
 
+template <class ParamType>
+bool JsonAttributeT<ParamType>::pollValueChange(std::string& buffer)
+{
+    buffer.clear();
+    JsonWriter writer(buffer);
+    writer.value(get());
+    if(buffer == lastValueJson)
+    {
+        return false;
+    }
+    lastValueJson.assign(buffer);
+    return true;
+}
+
+template <class ParamType>
+const std::string& JsonAttributeT<ParamType>::getLastValueJson() const
+{
+    return lastValueJson;
+}
+
 template <class ParamType>
 std::string JsonAttributeT<ParamType>::getValueAsString()
 {
@@ -538,6 +1083,64 @@ template <>
 inline void JsonAttributeT<bool>::setFromJson(Json::Value val) {set(val.asBool());}
 
 
+template <class ParamType>
+TypeValue JsonAttributeT<ParamType>::getTypeValue() const
+{
+    return getValueFromType<ParamType>();
+}
+
+template <>
+inline void JsonAttributeT<float>::applyUpdate(const ElementUpdate& update) {set(update.floatValue);}
+template <>
+inline void JsonAttributeT<double>::applyUpdate(const ElementUpdate& update) {set(update.doubleValue);}
+template <>
+inline void JsonAttributeT<int>::applyUpdate(const ElementUpdate& update) {set(update.intValue);}
+template <>
+inline void JsonAttributeT<std::string>::applyUpdate(const ElementUpdate& update) {set(update.stringValue);}
+template <>
+inline void JsonAttributeT<bool>::applyUpdate(const ElementUpdate& update) {set(update.boolValue);}
+
+
+template <>
+void JsonAttributeT<float>::writeBinaryValue(BinaryWriter& writer, bool quantize)
+{
+    float value = get();
+    float minVal, maxVal;
+    if(quantize && getMinMax(minVal, maxVal))
+    {
+        writer.record(getHandle(), BinaryProtocol::TAG_QUANTIZED);
+        writer.uint16(BinaryProtocol::quantize(value, minVal, maxVal));
+        return;
+    }
+    writer.record(getHandle(), BinaryProtocol::TAG_FLOAT);
+    writer.float32(value);
+}
+template <>
+void JsonAttributeT<double>::writeBinaryValue(BinaryWriter& writer, bool /*quantize*/)
+{
+    writer.record(getHandle(), BinaryProtocol::TAG_DOUBLE);
+    writer.float64(get());
+}
+template <>
+void JsonAttributeT<int>::writeBinaryValue(BinaryWriter& writer, bool /*quantize*/)
+{
+    writer.record(getHandle(), BinaryProtocol::TAG_INT);
+    writer.uint32((uint32_t)get());
+}
+template <>
+void JsonAttributeT<std::string>::writeBinaryValue(BinaryWriter& writer, bool /*quantize*/)
+{
+    writer.record(getHandle(), BinaryProtocol::TAG_STRING);
+    writer.string(get());
+}
+template <>
+void JsonAttributeT<bool>::writeBinaryValue(BinaryWriter& writer, bool /*quantize*/)
+{
+    writer.record(getHandle(), BinaryProtocol::TAG_BOOL);
+    writer.uint8(get() ? 1 : 0);
+}
+
+
 template <>
 inline std::string JsonAttributeT<float>::getValueType() {return "f";}
 template <>
@@ -555,27 +1158,48 @@ template class JsonAttributeT<int>;
 template class JsonAttributeT<std::string>;
 template class JsonAttributeT<bool>;
 
+JsonGroupBase::JsonGroupBase(const string &p, size_t i):
+    path(p),
+    index(i)
+{}
+
 void JsonGroupBase::add(std::shared_ptr<JsonNode> part)
 {
     tree.push_back(part);
 }
 
+const string &JsonGroupBase::getPath() const
+{
+    return path;
+}
+
+size_t JsonGroupBase::getIndex() const
+{
+    return index;
+}
+
+JsonTreeRoot::JsonTreeRoot():
+    JsonGroupBase("", 0)
+{}
+
 void JsonTreeRoot::clear()
 {
     tree.clear();
 }
 
-Json::Value JsonTreeRoot::getJsonStructure()
+void JsonTreeRoot::writeJsonStructure(JsonWriter &writer, bool withValues)
 {
-    Json::Value  rootJson;
-    for(auto item: tree)
+    writer.beginArray();
+    for(auto& item: tree)
     {
-        rootJson.append(item->getJsonStructure());
+        item->writeJsonStructure(writer, withValues);
     }
-    return rootJson;
+    writer.endArray();
 }
 
-JsonGroup::JsonGroup(string nn): name(nn)
+JsonGroup::JsonGroup(string nn, const string &path, size_t index):
+    JsonGroupBase(path, index),
+    name(nn)
 {}
 
 string JsonGroup::getName()
@@ -583,17 +1207,23 @@ string JsonGroup::getName()
     return name;
 }
 
-Json::Value JsonGroup::getJsonStructure()
+void JsonGroup::writeJsonStructure(JsonWriter &writer, bool withValues)
 {
-    Json::Value groupJson;
-    groupJson["type"] = "group";
-    groupJson["name"] = name;
-    Json::Value& subStructure = groupJson["content"];
-    for(auto item: tree)
+    writer.beginObject();
+    writer.key("type");
+    writer.value("group");
+    writer.key("name");
+    writer.value(name);
+    writer.key("path");
+    writer.value(getPath());
+    writer.key("content");
+    writer.beginArray();
+    for(auto& item: tree)
     {
-        subStructure.append(item->getJsonStructure());
+        item->writeJsonStructure(writer, withValues);
     }
-    return groupJson;
+    writer.endArray();
+    writer.endObject();
 }
 
 std::shared_ptr<JsonAction> factory::makeJson(std::shared_ptr<Action> wp)
@@ -609,12 +1239,30 @@ const string &JsonElement::getId() const { return id;}
 
 void JsonElement::setId(const string &i)  { id = i;}
 
+uint64_t JsonElement::getVersion() const { return version;}
+
+void JsonElement::setVersion(uint64_t v)  { version = v;}
+
+size_t JsonElement::getGroup() const { return group;}
+
+void JsonElement::setGroup(size_t g)  { group = g;}
+
+size_t JsonElement::getHandle() const { return handle;}
+
+void JsonElement::setHandle(size_t h)  { handle = h;}
+
+const string &JsonElement::getLastValueJson() const
+{
+    static const std::string nullJson = "null";
+    return nullJson;
+}
+
 
 
 
-Json::Value InterfaceManager::InterfaceImpl::getJsonStructure()
+JsonElementMap &InterfaceManager::InterfaceImpl::getMap()
 {
-    return getTree()->getJsonStructure();
+    return getRegistry().attributes;
 }
 
 void InterfaceManager::InterfaceImpl::addInteractionElement(const string &name, std::shared_ptr<JsonElement> ie)
@@ -631,7 +1279,11 @@ void InterfaceManager::InterfaceImpl::addInteractionElement(const string &name,
 
     ie->setId(id);
     ie->setName(name);
+    ie->setGroup(getTree()->getIndex());
+    ie->setHandle(getRegistry().elements.size());
     getMap()[id] = ie;
+    getRegistry().elements.push_back(ie);
+    getRegistry().journalInsert(getTree()->getPath(), ie);
     getTree()->add(ie);
 }
 
@@ -641,9 +1293,9 @@ void InterfaceManager::InterfaceImpl::addInteractionElement(const string &name,
 InterfaceManager::InterfaceRootImpl::InterfaceRootImpl():
     structure(new JsonTreeRoot()){}
 
-JsonElementMap &InterfaceManager::InterfaceRootImpl::getMap()
+InterfaceRegistry &InterfaceManager::InterfaceRootImpl::getRegistry()
 {
-    return attributes;
+    return registry;
 }
 
 std::shared_ptr<JsonGroupBase> InterfaceManager::InterfaceRootImpl::getTree()
@@ -653,17 +1305,23 @@ std::shared_ptr<JsonGroupBase> InterfaceManager::InterfaceRootImpl::getTree()
 
 void InterfaceManager::InterfaceRootImpl::clear()
 {
-    attributes.clear();
+    registry.attributes.clear();
+    registry.elements.clear();
+    registry.handleGeneration++;
+    //the removals are not journaled, so the clients will need the whole structure
+    registry.structureRevision++;
+    registry.journal.clear();
+    registry.groupPaths.resize(1);
     structure->clear();
 }
 
-InterfaceManager::InterfaceRefImpl::InterfaceRefImpl(std::shared_ptr<JsonGroupBase> s, JsonElementMap &m):
+InterfaceManager::InterfaceRefImpl::InterfaceRefImpl(std::shared_ptr<JsonGroupBase> s, InterfaceRegistry &r):
     structure(s),
-    attributes(m)
+    registry(r)
 { }
 
-JsonElementMap &InterfaceManager::InterfaceRefImpl::getMap()
-{return attributes;}
+InterfaceRegistry &InterfaceManager::InterfaceRefImpl::getRegistry()
+{return registry;}
 
 std::shared_ptr<JsonGroupBase> InterfaceManager::InterfaceRefImpl::getTree()
 {
@@ -39,6 +39,8 @@
 #include <string>
 #include <memory>
 #include <vector>
+#include <unordered_map>
+#include <cstdint>
 
 namespace Json{
 class Value;
@@ -46,6 +48,41 @@ class Value;
 
 namespace InstantInterface {
 
+/**
+ * @brief identifies an element of the interface without string lookup (see InterfaceManager::getElementHandles())
+ */
+struct ElementHandle
+{
+    // index of the element in the interface
+    size_t index;
+    // type of the value of the element, TYPE_UNDEFINED for an action
+    TypeValue type;
+};
+
+typedef std::unordered_map<std::string, ElementHandle> ElementHandleMap;
+
+/**
+ * @brief new value of an element of the interface, already converted to the type of the element.
+ * Only the member corresponding to \p type is meaningful.
+ */
+struct ElementUpdate
+{
+    ElementUpdate() : handle(0), handleGeneration(0), type(TYPE_UNDEFINED), doubleValue(0) {}
+
+    size_t handle;
+    // generation of the handles from which \p handle was taken (see InterfaceManager::getHandleGeneration())
+    uint64_t handleGeneration;
+    TypeValue type;
+    union
+    {
+        bool boolValue;
+        int intValue;
+        float floatValue;
+        double doubleValue;
+    };
+    std::string stringValue;
+};
+
 /**
  * @brief The InterfaceManager class is used to create a structured interface for a set of Attributes/Actions. The Attributes and Actions are added with addInteractionElement()
  * and the interface is structured with createGroup().
@@ -141,6 +178,33 @@ public:
      */
     std::string getStructureJsonString() const;
 
+    /**
+     * @brief writes the structure of the interface formated as a compact json string into \p buffer.
+     * The content of \p buffer is replaced, but its memory is reused.
+     * @param buffer
+     * @param withValues if false, the current values of the attributes are not included, so that the result only depends on the structure
+     */
+    void writeStructureJson(std::string& buffer, bool withValues = true) const;
+
+    /**
+     * @brief returns the revision of the structure, incremented by each structural edit (element or group added, interface cleared)
+     */
+    uint64_t getStructureRevision() const;
+
+    /**
+     * @brief writes into \p buffer the structural edits made after the revision \p since as a patch message:
+     * {"type":"patch","content":[{"op":"insert","group":<path of the parent group>,"node":<structure of the node>},...]}
+     * The nodes are listed in the order of insertion, the groups are inserted empty and filled by the next edits.
+     * @return false if the patch can't be built, because the interface has been cleared or because the journal
+     * doesn't go back to \p since anymore. The whole structure must be sent instead.
+     */
+    bool writeStructurePatchJson(std::string& buffer, uint64_t since) const;
+
+    /**
+     * @brief sets the maximum number of structural edits kept for writeStructurePatchJson() (1024 per default)
+     */
+    void setStructureJournalCapacity(size_t capacity);
+
     /**
      * @brief update the element (the attribute) associated with the name \p name and with the value described in the json object \p val
      * @param name id of the attribute
@@ -148,12 +212,105 @@ public:
      */
     void updateInterfaceElement(const std::string& name, const Json::Value& val);
 
+    /**
+     * @brief fills \p handles with the handle of each element of the interface, indexed by the id of the element.
+     * The handles stay valid as long as the interface is not cleared. They are also written in the structure ("handle" member of the elements).
+     * @param handles
+     * @return the generation of the handles (see getHandleGeneration())
+     */
+    uint64_t getElementHandles(ElementHandleMap& handles) const;
+
+    /**
+     * @brief returns the current generation of the handles, which changes each time the handles are invalidated by clear()
+     */
+    uint64_t getHandleGeneration() const;
+
+    /**
+     * @brief applies \p update to the element it designates, without json parsing nor string lookup
+     * @return false if the handle of \p update is not valid anymore or if its type doesn't match the element
+     */
+    bool applyElementUpdate(const ElementUpdate& update);
+
     /**
      * @brief get the current values of all the registered attributes as a json string
      * @return
      */
     std::string getStateJsonString() const;
 
+    /**
+     * @brief writes the current values of all the registered attributes formated as a compact json string into \p buffer.
+     * The content of \p buffer is replaced, but its memory is reused.
+     * @param buffer
+     */
+    void writeStateJson(std::string& buffer) const;
+
+    /**
+     * @brief reads the current values of all the registered attributes and gives a new state version to the ones that have changed since the last call
+     * @return the current state version
+     */
+    uint64_t pollStateChanges();
+
+    /**
+     * @brief get the values of the attributes that have changed after the state version \p since as a json string.
+     * The versions are computed by pollStateChanges()
+     * @param since state version from which the changes are taken into account
+     * @return
+     */
+    std::string getStateDeltaJsonString(uint64_t since) const;
+
+    /**
+     * @brief same as getStateDeltaJsonString() but the json string is written into \p buffer, whose memory is reused.
+     * @return true if at least one attribute has changed after the state version \p since
+     */
+    bool writeStateDeltaJson(std::string& buffer, uint64_t since) const;
+
+    /**
+     * @brief fills \p handles with the handles of the elements whose value has changed after the state version \p since (see pollStateChanges())
+     */
+    void getChangedElements(std::vector<size_t>& handles, uint64_t since) const;
+
+    /**
+     * @brief returns the value of the element \p handle read by the last call of pollStateChanges(), serialized in json
+     * ("null" if the element has no value, empty if \p handle is not valid)
+     */
+    const std::string& getPolledValueJson(size_t handle) const;
+
+    /**
+     * @brief returns the paths of the groups of the interface. The path of a group is made of the names of the groups from the root
+     * down to this group, separated by '/'. In the names, '%', '/' and '#' are escaped as "%25", "%2F" and "%23", and the n-th
+     * group named like one of its siblings gets the suffix "#n", so that each path identifies a single group. The path of each group
+     * is also given in the structure. The index of a path identifies the group. The root of the interface has the index 0 and the path "".
+     * @return
+     */
+    std::vector<std::string> getGroupPaths() const;
+
+    /**
+     * @brief writes the current values of the registered attributes group by group: \p fragments[i] receives the values of the attributes
+     * contained directly in the group i (see getGroupPaths()), as a comma separated list of {"id":...,"value":...} json objects.
+     * This way the update message of any set of groups can be assembled by concatenating fragments. The memory of the fragments is reused.
+     * @param fragments
+     */
+    void writeStateJsonByGroup(std::vector<std::string>& fragments) const;
+
+    /**
+     * @brief same as writeStateJsonByGroup() but only with the attributes that have changed after the state version \p since (see pollStateChanges())
+     * @return true if at least one attribute has changed after the state version \p since
+     */
+    bool writeStateDeltaJsonByGroup(std::vector<std::string>& fragments, uint64_t since) const;
+
+    /**
+     * @brief same as writeStateJsonByGroup() but the values are written as records of the binary protocol (see BinaryProtocol.h),
+     * identified by the handles of the elements. The update message is the concatenation of MESSAGE_UPDATE and of fragments.
+     * @param quantize if true, the float attributes with a min and a max are quantized on 16 bits
+     */
+    void writeStateBinaryByGroup(std::vector<std::string>& fragments, bool quantize) const;
+
+    /**
+     * @brief same as writeStateBinaryByGroup() but only with the attributes that have changed after the state version \p since (see pollStateChanges())
+     * @return true if at least one attribute has changed after the state version \p since
+     */
+    bool writeStateDeltaBinaryByGroup(std::vector<std::string>& fragments, uint64_t since, bool quantize) const;
+
     /**
      * @brief clears the content of the interface
      */
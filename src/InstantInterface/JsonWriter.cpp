@@ -0,0 +1,204 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#include "JsonWriter.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace InstantInterface {
+
+JsonWriter::JsonWriter(std::string &buffer):
+    out(buffer),
+    start(buffer.size())
+{}
+
+void JsonWriter::beginObject()
+{
+    separate();
+    out.push_back('{');
+}
+
+void JsonWriter::endObject()
+{
+    out.push_back('}');
+}
+
+void JsonWriter::beginArray()
+{
+    separate();
+    out.push_back('[');
+}
+
+void JsonWriter::endArray()
+{
+    out.push_back(']');
+}
+
+void JsonWriter::key(const char *k)
+{
+    separate();
+    writeString(k, strlen(k));
+    out.push_back(':');
+}
+
+void JsonWriter::key(const std::string &k)
+{
+    separate();
+    writeString(k.c_str(), k.size());
+    out.push_back(':');
+}
+
+void JsonWriter::value(bool v)
+{
+    separate();
+    out.append(v ? "true" : "false");
+}
+
+void JsonWriter::value(int v)
+{
+    separate();
+    char str[16];
+    int n = snprintf(str, sizeof(str), "%d", v);
+    out.append(str, n);
+}
+
+void JsonWriter::value(float v)
+{
+    if(!std::isfinite(v))
+    {
+        valueNull();
+        return;
+    }
+
+    separate();
+    //use the shortest representation that gives back the same float
+    char str[32];
+    int n = 0;
+    for(int precision = 6; precision <= 9; precision++)
+    {
+        n = snprintf(str, sizeof(str), "%.*g", precision, v);
+        if(strtof(str, nullptr) == v)
+            break;
+    }
+    out.append(str, n);
+}
+
+void JsonWriter::value(double v)
+{
+    if(!std::isfinite(v))
+    {
+        valueNull();
+        return;
+    }
+
+    separate();
+    char str[32];
+    int n = snprintf(str, sizeof(str), "%.15g", v);
+    if(strtod(str, nullptr) != v)
+        n = snprintf(str, sizeof(str), "%.17g", v);
+    out.append(str, n);
+}
+
+void JsonWriter::value(const char *v)
+{
+    separate();
+    writeString(v, strlen(v));
+}
+
+void JsonWriter::value(const std::string &v)
+{
+    separate();
+    writeString(v.c_str(), v.size());
+}
+
+void JsonWriter::valueNull()
+{
+    separate();
+    out.append("null");
+}
+
+void JsonWriter::valueRaw(const std::string &json)
+{
+    separate();
+    out.append(json);
+}
+
+void JsonWriter::separate()
+{
+    //a comma is required unless we are at the beginning of the document, of an object, of an array or after a key
+    if(out.size() == start)
+        return;
+
+    char last = out.back();
+    if(last != '{' && last != '[' && last != ':')
+        out.push_back(',');
+}
+
+void JsonWriter::writeString(const char *str, size_t length)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    out.push_back('"');
+    for(size_t i = 0; i<length; i++)
+    {
+        unsigned char c = str[i];
+        switch (c) {
+        case '"':  out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n"); break;
+        case '\r': out.append("\\r"); break;
+        case '\t': out.append("\\t"); break;
+        case '\b': out.append("\\b"); break;
+        case '\f': out.append("\\f"); break;
+        default:
+            if(c < 0x20)
+            {
+                out.append("\\u00");
+                out.push_back(hex[c >> 4]);
+                out.push_back(hex[c & 0xf]);
+            }
+            else
+            {
+                out.push_back(c);
+            }
+            break;
+        }
+    }
+    out.push_back('"');
+}
+
+}
@@ -0,0 +1,94 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#pragma once
+
+#include <string>
+
+namespace InstantInterface {
+
+/**
+ * @brief The JsonWriter class writes compact json directly at the end of a string buffer, without building an intermediate Json::Value.
+ * When the same buffer is cleared and reused, no allocation is required once it has reached its working size.
+ *
+ * example:
+ *  std::string buffer;
+ *  JsonWriter writer(buffer);
+ *  writer.beginObject();
+ *  writer.key("id");
+ *  writer.value(3);
+ *  writer.endObject();  // buffer == {"id":3}
+ */
+class JsonWriter
+{
+public:
+    /**
+     * @brief constructor
+     * @param buffer string at the end of which the json is written
+     */
+    JsonWriter(std::string& buffer);
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    /**
+     * @brief writes the key of the next member of the current object
+     */
+    void key(const char* k);
+    void key(const std::string& k);
+
+    void value(bool v);
+    void value(int v);
+    void value(float v);
+    void value(double v);
+    void value(const char* v);
+    void value(const std::string& v);
+    void valueNull();
+
+    /**
+     * @brief writes \p json, which must already be a valid serialized json value
+     */
+    void valueRaw(const std::string& json);
+
+private:
+    void separate();
+    void writeString(const char* str, size_t length);
+
+    std::string& out;
+    size_t start;
+};
+
+}
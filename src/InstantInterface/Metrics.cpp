@@ -0,0 +1,281 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#include "Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace InstantInterface {
+
+LatencyHistogram::LatencyHistogram() :
+    count(0),
+    sumNanoseconds(0),
+    maxNanoseconds(0)
+{
+    for(auto& bucket: buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+void LatencyHistogram::record(std::chrono::steady_clock::duration duration)
+{
+    auto nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+    recordNanoseconds(nanoseconds > 0 ? nanoseconds : 0);
+}
+
+void LatencyHistogram::recordNanoseconds(uint64_t nanoseconds)
+{
+    buckets[getBucket(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    count.fetch_add(1, std::memory_order_relaxed);
+    sumNanoseconds.fetch_add(nanoseconds, std::memory_order_relaxed);
+    uint64_t max = maxNanoseconds.load(std::memory_order_relaxed);
+    while(nanoseconds > max && !maxNanoseconds.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+    {
+    }
+}
+
+void LatencyHistogram::reset()
+{
+    for(auto& bucket: buckets)
+    {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    count.store(0, std::memory_order_relaxed);
+    sumNanoseconds.store(0, std::memory_order_relaxed);
+    maxNanoseconds.store(0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount() const
+{
+    return count.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::getSumSeconds() const
+{
+    return sumNanoseconds.load(std::memory_order_relaxed)*1e-9;
+}
+
+double LatencyHistogram::getMaxSeconds() const
+{
+    return maxNanoseconds.load(std::memory_order_relaxed)*1e-9;
+}
+
+double LatencyHistogram::getPercentileSeconds(double percentile) const
+{
+    //the total is computed from the buckets, which may be more recent than the count
+    uint64_t total = 0;
+    for(const auto& bucket: buckets)
+    {
+        total += bucket.load(std::memory_order_relaxed);
+    }
+    if(total == 0)
+    {
+        return 0;
+    }
+
+    uint64_t rank = (uint64_t)std::ceil(std::min(100.0, std::max(0.0, percentile))/100.0*total);
+    rank = std::max<uint64_t>(rank, 1);
+    uint64_t cumulated = 0;
+    for(unsigned int i = 0; i<BUCKET_COUNT; i++)
+    {
+        cumulated += buckets[i].load(std::memory_order_relaxed);
+        if(cumulated >= rank)
+        {
+            //the upper bound of the bucket, but never more than the largest duration recorded
+            uint64_t upper = i + 1 < BUCKET_COUNT ? getBucketLowest(i + 1) - 1 : UINT64_MAX;
+            return std::min(upper, maxNanoseconds.load(std::memory_order_relaxed))*1e-9;
+        }
+    }
+    return getMaxSeconds();
+}
+
+uint64_t LatencyHistogram::getCountBelow(double seconds) const
+{
+    if(seconds < 0)
+    {
+        return 0;
+    }
+    double nanoseconds = seconds*1e9;
+    uint64_t cumulated = 0;
+    for(unsigned int i = 0; i<BUCKET_COUNT; i++)
+    {
+        //the buckets entirely below the limit
+        if(i + 1 < BUCKET_COUNT && (double)getBucketLowest(i + 1) - 1 > nanoseconds)
+        {
+            break;
+        }
+        cumulated += buckets[i].load(std::memory_order_relaxed);
+    }
+    return cumulated;
+}
+
+void LatencyHistogram::dump(std::ostream &stream) const
+{
+    stream<<"count="<<getCount()
+          <<" p50="<<getPercentileSeconds(50)*1e3<<"ms"
+          <<" p90="<<getPercentileSeconds(90)*1e3<<"ms"
+          <<" p99="<<getPercentileSeconds(99)*1e3<<"ms"
+          <<" p99.9="<<getPercentileSeconds(99.9)*1e3<<"ms"
+          <<" max="<<getMaxSeconds()*1e3<<"ms";
+}
+
+unsigned int LatencyHistogram::getBucket(uint64_t nanoseconds)
+{
+    if(nanoseconds < SUB_BUCKET_COUNT)
+    {
+        return (unsigned int)nanoseconds;
+    }
+    unsigned int highestBit = 63;
+    while(!(nanoseconds >> highestBit))
+    {
+        highestBit--;
+    }
+    //the SUB_BUCKET_BITS bits after the highest one select the bucket within the power of two
+    unsigned int shift = highestBit - SUB_BUCKET_BITS;
+    return (shift + 1)*SUB_BUCKET_COUNT + (unsigned int)((nanoseconds >> shift) - SUB_BUCKET_COUNT);
+}
+
+uint64_t LatencyHistogram::getBucketLowest(unsigned int bucket)
+{
+    if(bucket < SUB_BUCKET_COUNT)
+    {
+        return bucket;
+    }
+    unsigned int shift = bucket/SUB_BUCKET_COUNT - 1;
+    return (uint64_t)(SUB_BUCKET_COUNT + bucket%SUB_BUCKET_COUNT) << shift;
+}
+
+PrometheusWriter::PrometheusWriter(std::string &buffer) :
+    buffer(buffer)
+{
+}
+
+void PrometheusWriter::header(const std::string &name, const std::string &help, const std::string &type)
+{
+    buffer.append("# HELP ").append(name).push_back(' ');
+    buffer.append(help).push_back('\n');
+    buffer.append("# TYPE ").append(name).push_back(' ');
+    buffer.append(type).push_back('\n');
+}
+
+void PrometheusWriter::sample(const std::string &name, double value, const std::string &labels)
+{
+    buffer.append(name);
+    if(!labels.empty())
+    {
+        buffer.append("{").append(labels).push_back('}');
+    }
+
+    char number[32];
+    if(std::isnan(value))
+    {
+        snprintf(number, sizeof(number), "NaN");
+    }
+    else if(std::isinf(value))
+    {
+        snprintf(number, sizeof(number), value > 0 ? "+Inf" : "-Inf");
+    }
+    else if(value == std::floor(value) && std::fabs(value) < 1e15)
+    {
+        //the counters are written as integers
+        snprintf(number, sizeof(number), "%.0f", value);
+    }
+    else
+    {
+        snprintf(number, sizeof(number), "%.9g", value);
+    }
+    buffer.push_back(' ');
+    buffer.append(number).push_back('\n');
+}
+
+void PrometheusWriter::counter(const std::string &name, const std::string &help, double value)
+{
+    header(name, help, "counter");
+    sample(name, value);
+}
+
+void PrometheusWriter::gauge(const std::string &name, const std::string &help, double value)
+{
+    header(name, help, "gauge");
+    sample(name, value);
+}
+
+void PrometheusWriter::durations(const std::string &name, const std::string &help, const DurationCounter &counter)
+{
+    header(name + "_seconds", help, "summary");
+    sample(name + "_seconds_sum", counter.getSeconds());
+    sample(name + "_seconds_count", counter.getCount());
+}
+
+void PrometheusWriter::histogram(const std::string &name, const LatencyHistogram &histogram, const std::string &labels)
+{
+    std::string separator = labels.empty() ? "" : ",";
+    for(unsigned int exponent = 10; exponent <= 36; exponent++)
+    {
+        double seconds = (double)(1ull << exponent)*1e-9;
+        char bound[32];
+        snprintf(bound, sizeof(bound), "%.9g", seconds);
+        sample(name + "_bucket", histogram.getCountBelow(seconds), labels + separator + "le=\"" + bound + "\"");
+    }
+    sample(name + "_bucket", histogram.getCount(), labels + separator + "le=\"+Inf\"");
+    sample(name + "_sum", histogram.getSumSeconds(), labels);
+    sample(name + "_count", histogram.getCount(), labels);
+}
+
+std::string PrometheusWriter::escapeLabel(const std::string &value)
+{
+    std::string escaped;
+    for(char c: value)
+    {
+        if(c == '\\' || c == '"')
+        {
+            escaped.push_back('\\');
+            escaped.push_back(c);
+        }
+        else if(c == '\n')
+        {
+            escaped.append("\\n");
+        }
+        else
+        {
+            escaped.push_back(c);
+        }
+    }
+    return escaped;
+}
+
+}
@@ -0,0 +1,221 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace InstantInterface {
+
+/**
+ * @brief number of messages and bytes received and sent, updated from any thread
+ */
+struct TrafficCounters
+{
+    TrafficCounters() : messagesReceived(0), bytesReceived(0), messagesSent(0), bytesSent(0) {}
+
+    void addReceived(size_t bytes)
+    {
+        messagesReceived.fetch_add(1, std::memory_order_relaxed);
+        bytesReceived.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    void addSent(size_t bytes)
+    {
+        messagesSent.fetch_add(1, std::memory_order_relaxed);
+        bytesSent.fetch_add(bytes, std::memory_order_relaxed);
+    }
+
+    std::atomic<uint64_t> messagesReceived;
+    std::atomic<uint64_t> bytesReceived;
+    std::atomic<uint64_t> messagesSent;
+    std::atomic<uint64_t> bytesSent;
+};
+
+/**
+ * @brief cumulated duration and number of runs of a task, updated from any thread
+ */
+class DurationCounter
+{
+public:
+    DurationCounter() : count(0), nanoseconds(0) {}
+
+    void add(std::chrono::steady_clock::duration duration)
+    {
+        count.fetch_add(1, std::memory_order_relaxed);
+        nanoseconds.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(), std::memory_order_relaxed);
+    }
+
+    uint64_t getCount() const
+    {
+        return count.load(std::memory_order_relaxed);
+    }
+
+    double getSeconds() const
+    {
+        return nanoseconds.load(std::memory_order_relaxed)*1e-9;
+    }
+
+    /**
+     * @brief adds the lifetime of the scope to a DurationCounter
+     */
+    class Scope
+    {
+    public:
+        Scope(DurationCounter& counter) : counter(counter), start(std::chrono::steady_clock::now()) {}
+        ~Scope()
+        {
+            counter.add(std::chrono::steady_clock::now() - start);
+        }
+
+    private:
+        DurationCounter& counter;
+        std::chrono::steady_clock::time_point start;
+    };
+
+private:
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> nanoseconds;
+};
+
+/**
+ * @brief The LatencyHistogram class counts durations in log-linear buckets (HDR-style): each power of two is split into 8 buckets,
+ * so that any duration from a nanosecond to hours is recorded with a relative error below 12.5%, in constant memory and without lock.
+ * The durations can be recorded from any thread.
+ */
+class LatencyHistogram
+{
+public:
+    // number of buckets per power of two, as a power of two
+    static const unsigned int SUB_BUCKET_BITS = 3;
+    static const unsigned int SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+    static const unsigned int BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+    LatencyHistogram();
+
+    void record(std::chrono::steady_clock::duration duration);
+
+    void recordNanoseconds(uint64_t nanoseconds);
+
+    /**
+     * @brief sets all the counts to 0. The durations recorded at the same time from other threads may be partially kept.
+     */
+    void reset();
+
+    uint64_t getCount() const;
+
+    double getSumSeconds() const;
+
+    double getMaxSeconds() const;
+
+    /**
+     * @brief returns the duration below which \p percentile % of the recorded durations are (upper bound of the bucket), 0 if empty
+     */
+    double getPercentileSeconds(double percentile) const;
+
+    /**
+     * @brief returns the number of recorded durations lower than or equal to \p seconds, rounded to the bucket boundaries
+     */
+    uint64_t getCountBelow(double seconds) const;
+
+    /**
+     * @brief writes the count, the main percentiles and the maximum in milliseconds, on one line
+     */
+    void dump(std::ostream& stream) const;
+
+    /**
+     * @brief returns the bucket of \p nanoseconds
+     */
+    static unsigned int getBucket(uint64_t nanoseconds);
+
+    /**
+     * @brief returns the lowest duration of the \p bucket in nanoseconds (the highest one is the lowest of the next bucket minus 1)
+     */
+    static uint64_t getBucketLowest(unsigned int bucket);
+
+private:
+    std::atomic<uint64_t> buckets[BUCKET_COUNT];
+    std::atomic<uint64_t> count;
+    std::atomic<uint64_t> sumNanoseconds;
+    std::atomic<uint64_t> maxNanoseconds;
+};
+
+/**
+ * @brief The PrometheusWriter class appends metrics to a buffer in the Prometheus text exposition format (version 0.0.4)
+ */
+class PrometheusWriter
+{
+public:
+    PrometheusWriter(std::string& buffer);
+
+    /**
+     * @brief writes the HELP and TYPE lines of the metric \p name
+     * @param type "counter", "gauge", "summary"...
+     */
+    void header(const std::string& name, const std::string& help, const std::string& type);
+
+    /**
+     * @brief writes a sample of the metric \p name, with the \p labels already formatted as name="value" pairs separated by commas
+     */
+    void sample(const std::string& name, double value, const std::string& labels = "");
+
+    void counter(const std::string& name, const std::string& help, double value);
+
+    void gauge(const std::string& name, const std::string& help, double value);
+
+    /**
+     * @brief writes the _seconds_sum and _seconds_count samples of a summary without quantiles
+     */
+    void durations(const std::string& name, const std::string& help, const DurationCounter& counter);
+
+    /**
+     * @brief writes the samples of a histogram in seconds (without header), with the buckets at the powers of two
+     * from about a microsecond to a minute
+     */
+    void histogram(const std::string& name, const LatencyHistogram& histogram, const std::string& labels = "");
+
+    /**
+     * @brief returns \p value escaped for being a label value
+     */
+    static std::string escapeLabel(const std::string& value);
+
+private:
+    std::string& buffer;
+};
+
+}
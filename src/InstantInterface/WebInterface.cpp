@@ -33,21 +33,72 @@
 //M*/
 
 #include "WebInterface.h"
+#include "JsonWriter.h"
 #include <json/json.h>
 
+#include <zlib.h>
+
+#include <algorithm>
 #include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
 namespace InstantInterface
 {
 
-WebInterface::WebInterface(bool withThread) :
-    m_count(0),
+namespace
+{
+// time at which the message being handled by the thread has been received, given to the commands parsed from it
+thread_local std::chrono::steady_clock::time_point messageReceived;
+
+// names of the latency stages, in the order of WebInterface::LatencyStage
+const char* latencyStageNames[] = {"parse", "queue", "apply", "total", "client"};
+}
+
+WebInterface::WebInterface(bool withThread, size_t commandQueueCapacity) :
+    m_msgManager(std::make_shared<server_config::con_msg_manager_type>()),
+    httpRequests(0),
+    connectionsOpened(0),
+    connectionsClosed(0),
+    metricsPath("/metrics"),
+    commandQueue(commandQueueCapacity),
+    waitingForCommands(false),
+    commandFd(-1),
+    commandFdSignaled(false),
+    coalesceUpdates(false),
+    coalescedCount(0),
+    m_stopped(false),
+    threadCount(1),
     threaded(withThread),
-    structureCache(""),
-    valuesCache(""),
-    m_stopped(false)
+    binaryConnectionCount(0),
+    binaryQuantization(false),
+    codecs(1),
+    codecConnectionCounts(1, 0),
+    activeCodecs(0),
+    compressionEnabled(true),
+    compressionThreshold(1024),
+    sendBufferLimit(256*1024),
+    maxLag(0),
+    deferredBroadcastCount(0),
+    structureGeneration(1),
+    resumeCapacity(128),
+    resumeBaseVersion(std::numeric_limits<uint64_t>::max()),
+    deltaRefresh(false),
+    fullRefreshPeriod(100),
+    refreshCount(0),
+    lastRefreshVersion(0),
+    broadcastPeriod(0),
+    broadcastGeneration(0),
+    listenFd(-1),
+    handlersPending(false)
 {
     // set up access channels to only log interesting things
     m_endpoint.clear_access_channels(websocketpp::log::alevel::all);
@@ -58,6 +109,7 @@ WebInterface::WebInterface(bool withThread) :
 
     // Initialize the Asio transport policy
     m_endpoint.init_asio();
+    broadcastStrand.reset(new websocketpp::lib::asio::io_service::strand(m_endpoint.get_io_service()));
 
     // Bind the handlers we are using
     using websocketpp::lib::placeholders::_1;
@@ -67,6 +119,23 @@ WebInterface::WebInterface(bool withThread) :
     m_endpoint.set_close_handler(bind(&WebInterface::on_close,this,_1));
     m_endpoint.set_http_handler(bind(&WebInterface::on_http,this,_1));
     m_endpoint.set_message_handler(bind(&WebInterface::on_message,this,_1,_2));
+    m_endpoint.set_validate_handler(bind(&WebInterface::on_validate,this,_1));
+    m_endpoint.set_tcp_pre_bind_handler(bind(&WebInterface::on_tcp_pre_bind,this,_1));
+    m_endpoint.set_socket_init_handler(bind(&WebInterface::on_socket_init,this,_1,_2));
+
+    addWireCodec(std::make_shared<MessagePackCodec>());
+    addWireCodec(std::make_shared<CborCodec>());
+
+    //empty snapshots until the caches are updated, considered as already broadcast
+    structureSnapshot = std::make_shared<StructureSnapshot>();
+    valuesSnapshot = std::make_shared<ValuesSnapshot>();
+    broadcastStructureSnapshot = structureSnapshot;
+    broadcastValuesSnapshot = valuesSnapshot;
+
+    std::random_device random;
+    char session[17];
+    snprintf(session, sizeof(session), "%08x%08x", (unsigned int)random(), (unsigned int)random());
+    sessionId = session;
 
 }
 
@@ -79,29 +148,150 @@ bool WebInterface::poll()
         std::cout << e.what() << std::endl;
     }
 
+    handlersPending = false;
+
     return !m_stopped;
 }
 
+size_t WebInterface::poll(size_t maxHandlers, std::chrono::microseconds maxDuration)
+{
+    auto start = std::chrono::steady_clock::now();
+    size_t count = 0;
+    handlersPending = false;
+
+    try {
+        //poll_one() returns 0 once no handler is ready
+        while(m_endpoint.poll_one() > 0)
+        {
+            count++;
+            if((maxHandlers > 0 && count >= maxHandlers) ||
+               (maxDuration.count() > 0 && std::chrono::steady_clock::now() - start >= maxDuration))
+            {
+                //there may be other ready handlers, the next getPollTimeout() asks to come back immediately
+                handlersPending = true;
+                break;
+            }
+        }
+    } catch (websocketpp::exception const & e) {
+        std::cout << e.what() << std::endl;
+    }
+
+    return count;
+}
+
+std::vector<int> WebInterface::getFileDescriptors()
+{
+    std::vector<int> fds;
+
+    scoped_lock lock(parametersMutex);
+    if(listenFd >= 0)
+    {
+        fds.push_back(listenFd);
+    }
+    for(auto it = socketFds.begin(); it != socketFds.end();)
+    {
+        if(it->first.expired())
+        {
+            //the connection has been destroyed, and its socket closed
+            it = socketFds.erase(it);
+        }
+        else
+        {
+            fds.push_back(it->second);
+            ++it;
+        }
+    }
+    return fds;
+}
+
+std::chrono::milliseconds WebInterface::getPollTimeout(std::chrono::milliseconds maxTimeout)
+{
+    if(handlersPending)
+    {
+        return std::chrono::milliseconds(0);
+    }
+
+    //without thread, the broadcast timer is only accessed from the thread of the program
+    if(!threaded && broadcastPeriod > 0)
+    {
+        //rounded up, so that the timer has expired when the event loop returns
+        auto remaining = nextBroadcast - std::chrono::steady_clock::now() + std::chrono::milliseconds(1) - std::chrono::nanoseconds(1);
+        auto timeout = std::chrono::duration_cast<std::chrono::milliseconds>(remaining);
+        return std::max(std::chrono::milliseconds(0), std::min(timeout, maxTimeout));
+    }
+    return maxTimeout;
+}
+
 void WebInterface::stop()
 {
     //do not accept new connection
     m_endpoint.stop_listening();
 
     //close properly all existing connections
-    for(auto& it: m_connections)
+    std::vector<connection_hdl> connections;
+    {
+        scoped_lock lock(parametersMutex);
+        listenFd = -1;
+        for(auto& it: m_connections)
+        {
+            connections.push_back(it.first);
+        }
+    }
+    for(auto& hdl: connections)
     {
-        m_endpoint.close(it,websocketpp::close::status::normal, "close button pressed");
+        websocketpp::lib::error_code ec;
+        m_endpoint.close(hdl,websocketpp::close::status::normal, "close button pressed", ec);
     }
 
+    //cancel the broadcast timer, otherwise the server keeps on running
+    setBroadcastRate(0);
+
     m_stopped = true;
+    {
+        //the program waiting for commands returns
+        std::lock_guard<std::mutex> lock(commandMutex);
+    }
+    commandSignal.notify_all();
+
+    for(auto& thread: threads)
+    {
+        if(thread.joinable())
+        {
+            thread.join();
+        }
+    }
+    threads.clear();
+}
+
+WebInterface::~WebInterface()
+{
+#ifdef __linux__
+    if(commandFd >= 0)
+    {
+        close(commandFd);
+    }
+#endif
+}
 
-    thread.join();
+void WebInterface::setAssetRefreshInterval(std::chrono::milliseconds interval)
+{
+    m_assets.setRefreshInterval(interval);
+}
+
+void WebInterface::setThreadCount(unsigned int count)
+{
+    threadCount = std::max(1u, count);
 }
 
 void WebInterface::init(uint16_t port, std::string docroot) {
     std::stringstream ss;
 
-    if(docroot == "#")
+    if(docroot == "#" && AssetCache::hasEmbeddedAssets())
+    {
+        //the web interface has been compiled into the library, nothing to read from disk
+        docroot.clear();
+    }
+    else if(docroot == "#")
     {
         //in this case we look for the path in the file pathToWebInterface.txt
 
@@ -116,11 +306,15 @@ void WebInterface::init(uint16_t port, std::string docroot) {
         }
     }
 
-    ss << "Running telemetry server on port "<< port <<" using docroot=" << docroot;
+    ss << "Running telemetry server on port "<< port <<" using docroot=" << (docroot.empty() ? "(embedded)" : docroot);
     m_endpoint.get_alog().write(websocketpp::log::alevel::app,ss.str());
 
     m_docroot = docroot;
 
+    //the files of the web interface are read once, the http requests are served from memory
+    size_t assetCount = m_docroot.empty() ? m_assets.loadEmbedded() : m_assets.load(m_docroot);
+    m_endpoint.get_alog().write(websocketpp::log::alevel::app, std::to_string(assetCount)+" files of the web interface loaded");
+
     // listen on specified port
     m_endpoint.listen(port);
 
@@ -134,12 +328,21 @@ void WebInterface::run()
 {
     updateStructureCache();
     updateParameterCache();
+    {
+        //the clients receive this structure when they connect, so the first patch can be computed from it
+        scoped_lock lock(parametersMutex);
+        std::atomic_store(&broadcastStructureSnapshot, std::atomic_load(&structureSnapshot));
+    }
 
     // Start the ASIO io_service run loop
     try {
         if(threaded)
         {
-            thread = std::thread(&server::run,&m_endpoint);
+            //the handlers of a connection are serialized by its strand, so several threads can run the server
+            for(unsigned int i = 0; i<threadCount; i++)
+            {
+                threads.emplace_back(&server::run,&m_endpoint);
+            }
         }
         else
         {
@@ -151,32 +354,38 @@ void WebInterface::run()
 }
 
 void WebInterface::on_message(websocketpp::connection_hdl hdl, server::message_ptr msg) {
+    messageReceived = std::chrono::steady_clock::now();
 
-
-    if (msg->get_opcode() == websocketpp::frame::opcode::text) {
-        std::string content = msg->get_payload();
-        if(content == "send_interface")
-        {
-            send_interface(hdl);
-        }
-        else if (content == "update")
+    size_t codec = 0;
+    {
+        scoped_lock lock(parametersMutex);
+        auto con = m_connections.find(hdl);
+        if(con != m_connections.end())
         {
-            send_values_update(hdl);
+            codec = con->second.codec;
+            con->second.traffic->addReceived(msg->get_payload().size());
         }
-        else
-        {
-            //this must contain json, so we try to do the udpate
-
-            if(threaded)
-            {
-                addCommand(content);
-            }
-            else
-            {
-                executeSingleCommand(content);
-            }
+    }
+    traffic.addReceived(msg->get_payload().size());
 
+    if (codec != 0)
+    {
+        //all the messages of the client are encoded by its codec
+        Json::Value message;
+        if(!codecs[codec]->decode(msg->get_payload(), message))
+        {
+            std::cout<<"Couldn't decode received message with "<<codecs[codec]->getSubprotocol()<<"."<<std::endl;
+            return;
         }
+        on_decoded(hdl, message);
+    }
+    else if (msg->get_opcode() == websocketpp::frame::opcode::text)
+    {
+        on_text(hdl, msg->get_payload());
+    }
+    else if (msg->get_opcode() == websocketpp::frame::opcode::binary)
+    {
+        parseBinaryCommand(hdl, msg->get_payload());
     }
     else
     {
@@ -184,152 +393,1857 @@ void WebInterface::on_message(websocketpp::connection_hdl hdl, server::message_p
     }
 }
 
-void WebInterface::send_interface(websocketpp::connection_hdl hdl)
+void WebInterface::on_decoded(connection_hdl hdl, const Json::Value &message)
 {
-    if (threaded)
+    if(message.isString())
     {
-        scoped_lock lock(parametersMutex);
-        m_endpoint.send(hdl,structureCache,websocketpp::frame::opcode::text);
+        on_text(hdl, message.asString());
     }
     else
     {
-        m_endpoint.send(hdl,getStructureJsonString(),websocketpp::frame::opcode::text);
+        parseCommand(hdl, message, "");
     }
-    //after sending the interface we send the update of all the parameters, because the structure of the interface
-    //is stored in json::value that is not synchronized with the actual values of the parameters
-    send_values_update(hdl);
 }
 
-void WebInterface::send_values_update(websocketpp::connection_hdl hdl)
+void WebInterface::on_text(connection_hdl hdl, const string &content)
 {
-    if(threaded)
+    if(content == "send_interface")
+    {
+        send_interface(hdl);
+    }
+    else if (content.compare(0, 15, "send_interface ") == 0)
+    {
+        //the client already has a structure, identified by its hash
+        send_interface(hdl, content.substr(15));
+    }
+    else if (content.compare(0, 7, "resume ") == 0)
+    {
+        //reconnection of a client: "resume <session> <version> <hash>"
+        std::istringstream arguments(content.substr(7));
+        std::string session;
+        uint64_t version = 0;
+        std::string knownHash;
+        arguments >> session >> version >> knownHash;
+        resume(hdl, session, arguments ? version : 0, knownHash);
+    }
+    else if (content == "update")
+    {
+        send_values_update(hdl);
+    }
+    else if (content == "accept_patches")
     {
+        //the client applies the "patch" messages, the older clients only handle whole structures
         scoped_lock lock(parametersMutex);
-        m_endpoint.send(hdl,valuesCache,websocketpp::frame::opcode::text);
+        auto con = m_connections.find(hdl);
+        if(con != m_connections.end())
+        {
+            con->second.acceptsPatches = true;
+        }
+    }
+    else if (content.compare(0, 10, "subscribe ") == 0)
+    {
+        subscribe(hdl, content.substr(10), true);
+        send_values_update(hdl);
+    }
+    else if (content.compare(0, 12, "unsubscribe ") == 0)
+    {
+        subscribe(hdl, content.substr(12), false);
     }
     else
     {
-        m_endpoint.send(hdl,getStateJsonString(),websocketpp::frame::opcode::text);
+        //this must contain json, so we try to do the udpate
+        //in threaded mode, the message is parsed here, so that the program thread only has to apply the typed updates
+        parseCommand(hdl, content);
     }
 }
 
-void WebInterface::addCommand(const std::string &command)
+void WebInterface::send_interface(websocketpp::connection_hdl hdl, const std::string& knownHash)
 {
-    scoped_lock lock (mainPrgMessagesMutex);
-    mainPrgMessages.push(command);
-}
+    if (!threaded)
+    {
+        //we are in the thread of the program, so the attributes can be read directly
+        updateStructureCache();
+    }
 
-void WebInterface::executeCommands()
-{
+    structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+    PendingSend send;
+    {
+        scoped_lock lock(parametersMutex);
+        //the structure is only downloaded if the client doesn't have it yet
+        send = makeSend(hdl, !knownHash.empty() && knownHash == structure->hash ? structure->unchanged : structure->structure);
+        auto con = m_connections.find(hdl);
+        if(con != m_connections.end())
+        {
+            con->second.structureHash = structure->hash;
+        }
+    }
+    sendFrame(send);
 
-    std::queue<std::string> queueCopy;
+    //after sending the interface we send the update of all the parameters, because the structure of the interface
+    //is stored in json::value that is not synchronized with the actual values of the parameters
+    send_values_update(hdl);
+}
 
+void WebInterface::resume(connection_hdl hdl, const std::string& session, uint64_t version, const std::string& knownHash)
+{
+    values_snapshot_ptr values = std::atomic_load(&valuesSnapshot);
+    structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+    SendList sends;
+    SubscriptionList subscriptions;
+    bool resumed = false;
     {
-        scoped_lock lock (mainPrgMessagesMutex);
-        queueCopy = std::move(mainPrgMessages);
+        scoped_lock lock(parametersMutex);
+        auto con = m_connections.find(hdl);
+        if(con != m_connections.end() && session == sessionId && version != 0 && version >= resumeBaseVersion && version <= values->version &&
+                !knownHash.empty() && knownHash == structure->hash)
+        {
+            if(!con->second.subscriptions.empty())
+            {
+                //the logged deltas contain all the groups, so a client with subscriptions receives the current values of its groups instead
+                sends.push_back(makeValuesSend(*con, *values, *structure, subscriptions));
+            }
+            else
+            {
+                //the values are states, so a delta starting before the version of the client can be sent again
+                for(auto& record: resumeLog)
+                {
+                    if(record.version > version)
+                    {
+                        sends.push_back(makeSend(*con, con->second.binary && record.binaryFrame ? record.binaryFrame : record.frame));
+                    }
+                }
+            }
+            con->second.structureHash = structure->hash;
+            resumed = true;
+        }
     }
 
+    if(!resumed)
+    {
+        send_interface(hdl, knownHash);
+        return;
+    }
+    assembleSubscriptions(*values, subscriptions, sends);
+    for(auto& send: sends)
+    {
+        sendFrame(send);
+    }
+}
 
-    std::string content;
-
-    while(!queueCopy.empty())
+void WebInterface::send_values_update(websocketpp::connection_hdl hdl)
+{
+    if(!threaded)
     {
-        content = queueCopy.front();
-        queueCopy.pop();
+        updateParameterCache();
+    }
 
-        executeSingleCommand(content);
+    values_snapshot_ptr values = std::atomic_load(&valuesSnapshot);
+    structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+    SendList sends;
+    SubscriptionList subscriptions;
+    {
+        scoped_lock lock(parametersMutex);
+        auto con = m_connections.find(hdl);
+        sends.push_back(con == m_connections.end() ? makeSend(hdl, values->values) : makeValuesSend(*con, *values, *structure, subscriptions));
     }
+    assembleSubscriptions(*values, subscriptions, sends);
+    sendFrame(sends.front());
+}
 
+WebInterface::PendingSend WebInterface::makeValuesSend(con_list::value_type &connection, const ValuesSnapshot &values,
+                                                     const StructureSnapshot &structure, SubscriptionList &subscriptions)
+{
+    bool binary = connection.second.binary && values.binaryValues;
+    if(connection.second.subscriptions.empty())
+    {
+        return makeSend(connection, binary ? values.binaryValues : values.values);
+    }
+    PendingSend send = makeSend(connection, nullptr);
+    send.subscription = addSubscription(subscriptions, binary, false, getGroupMask(connection.second, structure));
+    return send;
 }
 
-bool WebInterface::executeSingleCommand(const string &content)
+bool WebInterface::checkCongestion(con_list::value_type &connection)
 {
-    Json::Reader reader;
-    Json::Value messageJson;
-    bool success = reader.parse(content.c_str(), messageJson);
-    if(!success)
+    ConnectionData& data = connection.second;
+    if(sendBufferLimit == 0 || !data.connection || data.connection->get_buffered_amount() <= sendBufferLimit)
     {
-        std::cout<<"Couldn't parse received message to json."<<std::endl;
+        data.congested = false;
         return false;
     }
 
-    if(messageJson["type"].asString()=="update")
+    auto now = std::chrono::steady_clock::now();
+    if(!data.congested)
     {
-        Json::Value updates = messageJson["content"];
-        for(Json::ValueIterator itr = updates.begin(); itr != updates.end(); itr++)
+        data.congested = true;
+        data.congestedSince = now;
+    }
+    else if(maxLag.count() > 0 && !data.closing && now - data.congestedSince > maxLag)
+    {
+        data.closing = true;
+        laggingConnections.push_back(connection.first);
+    }
+    return true;
+}
+
+void WebInterface::collectPendingBroadcasts(const ValuesSnapshot &values, const StructureSnapshot &structure, SendList &sends,
+                                            SubscriptionList &subscriptions)
+{
+    for(auto& it: m_connections)
+    {
+        ConnectionData& data = it.second;
+        if((!data.structurePending && !data.valuesPending) || checkCongestion(it))
         {
-            std::string paramId = (*itr)["id"].asString();
-            updateInterfaceElement(paramId,(*itr)["value"]);
+            continue;
         }
-        return true;
+
+        //the skipped broadcasts are replaced by the current state, whatever happened in between
+        if(data.structurePending)
+        {
+            sends.push_back(makeSend(it, structure.structure));
+            data.structureHash = structure.hash;
+        }
+        //the values contain the acknowledged edits, or the values which override them
+        collectAcknowledgement(it, sends);
+        sends.push_back(makeValuesSend(it, values, structure, subscriptions));
+        data.structurePending = false;
+        data.valuesPending = false;
     }
+}
 
-    return false;
+void WebInterface::closeLaggingConnections()
+{
+    std::vector<connection_hdl> lagging;
+    {
+        scoped_lock lock(parametersMutex);
+        lagging.swap(laggingConnections);
+    }
+    for(auto& hdl: lagging)
+    {
+        websocketpp::lib::error_code ec;
+        m_endpoint.close(hdl, websocketpp::close::status::try_again_later, "client too slow", ec);
+        if(ec)
+        {
+            std::cout<<"InstantInterface::WebInterface, couldn't close a lagging connection: "<<ec.message()<<std::endl;
+        }
+    }
 }
 
-void WebInterface::updateStructureCache()
+void WebInterface::setBackpressure(size_t sendBufferLimit, std::chrono::milliseconds maxLag)
 {
-    scoped_lock lock (parametersMutex);
-    structureCache = this->getStructureJsonString();
+    scoped_lock lock(parametersMutex);
+    this->sendBufferLimit = sendBufferLimit;
+    this->maxLag = maxLag;
 }
 
-void WebInterface::updateParameterCache()
+uint64_t WebInterface::getDeferredBroadcastCount()
 {
-    scoped_lock lock (parametersMutex);
-    valuesCache = this->getStateJsonString();
+    scoped_lock lock(parametersMutex);
+    return deferredBroadcastCount;
 }
 
-void WebInterface::forceRefreshAll()
+void WebInterface::subscribe(WebInterface::connection_hdl hdl, const string &groupPath, bool enable)
 {
-    updateParameterCache();
+    scoped_lock lock(parametersMutex);
+    auto con = m_connections.find(hdl);
+    if(con == m_connections.end())
+    {
+        return;
+    }
 
-    for(auto& it: m_connections)
+    if(enable)
+    {
+        con->second.subscriptions.insert(groupPath);
+    }
+    else
     {
-        send_values_update(it);
+        con->second.subscriptions.erase(groupPath);
     }
+
+    //the mask will be recomputed at the next use
+    con->second.maskGeneration = 0;
 }
 
-void WebInterface::forceRefreshStructureAll()
+const std::vector<bool> &WebInterface::getGroupMask(WebInterface::ConnectionData &data, const StructureSnapshot &structure)
 {
-    updateStructureCache();
-
-    for(auto& it: m_connections)
+    if(data.maskGeneration != structure.generation)
     {
-        send_interface(it);
+        const std::vector<std::string>& groupPaths = structure.groupPaths;
+        data.groupMask.assign(groupPaths.size(), false);
+        for(size_t i = 0; i<groupPaths.size(); i++)
+        {
+            const std::string& path = groupPaths[i];
+            for(const std::string& subscription: data.subscriptions)
+            {
+                //a subscription to a group includes all its subgroups
+                if(subscription.empty() || path == subscription ||
+                        (path.size() > subscription.size() && path.compare(0, subscription.size(), subscription) == 0 && path[subscription.size()] == '/'))
+                {
+                    data.groupMask[i] = true;
+                    break;
+                }
+            }
+        }
+        data.maskGeneration = structure.generation;
     }
+    return data.groupMask;
 }
 
+bool WebInterface::assembleUpdate(string &buffer, const std::vector<string> &fragments, const std::vector<bool> &mask, uint64_t version)
+{
+    buffer.assign("{\"type\":\"update\",");
+    if(version != 0)
+    {
+        //the last version received is the point from which a reconnecting client resumes
+        buffer.append("\"version\":").append(std::to_string(version)).push_back(',');
+    }
+    buffer.append("\"content\":[");
+    bool empty = true;
+    for(size_t i = 0; i<fragments.size(); i++)
+    {
+        //the groups that are not in the mask (for instance created after the last structure update) are excluded
+        if(fragments[i].empty() || (i < mask.size() ? !mask[i] : true))
+        {
+            continue;
+        }
+        if(!empty)
+        {
+            buffer.push_back(',');
+        }
+        buffer.append(fragments[i]);
+        empty = false;
+    }
+    buffer.append("]}");
+    return !empty;
+}
 
-void WebInterface::on_http(WebInterface::connection_hdl hdl) {
-    // Upgrade our connection handle to a full connection_ptr
-    server::connection_ptr con = m_endpoint.get_con_from_hdl(hdl);
+bool WebInterface::assembleBinaryUpdate(string &buffer, const std::vector<string> &fragments, const std::vector<bool> &mask)
+{
+    buffer.assign(1, (char)BinaryProtocol::MESSAGE_UPDATE);
+    for(size_t i = 0; i<fragments.size() && i<mask.size(); i++)
+    {
+        if(mask[i])
+        {
+            buffer.append(fragments[i]);
+        }
+    }
+    return buffer.size() > 1;
+}
 
-    std::ifstream file;
-    std::string filename = con->get_uri()->get_resource();
-    std::string response;
+void WebInterface::collectUpdates(const ValuesSnapshot &values, const StructureSnapshot &structure, bool delta, SendList &sends,
+                                  SubscriptionList &subscriptions)
+{
+    frame_ptr sharedFrame = delta ? values.delta : values.values;
+    frame_ptr sharedBinaryFrame = delta ? values.binaryDelta : values.binaryValues;
 
-    m_endpoint.get_alog().write(websocketpp::log::alevel::app,
-                                "http request1: "+filename);
+    for(auto& it: m_connections)
+    {
+        if(delta && values.echoOnly && !it.first.owner_before(values.echoOrigin) && !values.echoOrigin.owner_before(it.first))
+        {
+            //the delta only contains the values sent by this client
+            continue;
+        }
+        if(it.second.structurePending || it.second.valuesPending)
+        {
+            //the client will receive all the values once it has caught up
+            continue;
+        }
+        if(checkCongestion(it))
+        {
+            it.second.valuesPending = true;
+            deferredBroadcastCount++;
+            continue;
+        }
 
+        bool binary = it.second.binary && sharedBinaryFrame;
+        if(it.second.subscriptions.empty())
+        {
+            sends.push_back(makeSend(it, binary ? sharedBinaryFrame : sharedFrame));
+            continue;
+        }
 
-    if (filename == "/") {
-        filename = m_docroot+"index.html";
-    } else {
-        filename = m_docroot+filename.substr(1);
+        PendingSend send = makeSend(it, nullptr);
+        send.subscription = addSubscription(subscriptions, binary, delta, getGroupMask(it.second, structure));
+        sends.push_back(send);
     }
+}
 
-    m_endpoint.get_alog().write(websocketpp::log::alevel::app,
-                                "http request2: "+filename);
+size_t WebInterface::addSubscription(SubscriptionList &subscriptions, bool binary, bool delta, const std::vector<bool> &mask)
+{
+    // the clients with the same subscriptions and the same protocol share the same frame
+    for(size_t i = 0; i<subscriptions.size(); i++)
+    {
+        if(subscriptions[i].binary == binary && subscriptions[i].delta == delta && subscriptions[i].mask == mask)
+        {
+            return i + 1;
+        }
+    }
+    subscriptions.push_back(SubscriptionUpdate{binary, delta, mask});
+    return subscriptions.size();
+}
 
-    file.open(filename.c_str(), std::ios::in);
-    if (!file) {
-        // 404 error
-        std::stringstream ss;
+void WebInterface::assembleSubscriptions(const ValuesSnapshot &values, const SubscriptionList &subscriptions, SendList &sends)
+{
+    if(subscriptions.empty())
+    {
+        return;
+    }
 
-        ss << "<!doctype html><html><head>"
+    static thread_local std::string buffer;
+    std::vector<frame_ptr> frames(subscriptions.size());
+    for(size_t i = 0; i<subscriptions.size(); i++)
+    {
+        const SubscriptionUpdate& update = subscriptions[i];
+        //an empty delta isn't sent
+        if(update.binary)
+        {
+            if(assembleBinaryUpdate(buffer, update.delta ? values.binaryDeltaFragments : values.binaryValueFragments, update.mask) || !update.delta)
+            {
+                frames[i] = makeFrame(buffer, websocketpp::frame::opcode::binary);
+            }
+        }
+        else if(assembleUpdate(buffer, update.delta ? values.deltaFragments : values.valueFragments, update.mask, values.version) || !update.delta)
+        {
+            frames[i] = makeFrame(buffer);
+        }
+    }
+
+    for(auto& send: sends)
+    {
+        if(send.subscription != 0)
+        {
+            send.frame = frames[send.subscription - 1];
+            send.subscription = 0;
+        }
+    }
+}
+
+namespace
+{
+/**
+ * @brief raw deflate stream reused for all the messages compressed by a thread
+ */
+class MessageDeflater
+{
+public:
+    MessageDeflater() : stream(z_stream()), initialized(false)
+    {
+        //raw deflate with the maximum window, as expected by permessage-deflate without server_max_window_bits
+        initialized = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    }
+
+    ~MessageDeflater()
+    {
+        if(initialized)
+        {
+            deflateEnd(&stream);
+        }
+    }
+
+    /**
+     * @brief compresses \p data into \p output as the payload of a permessage-deflate message
+     * @return false if the compression failed
+     */
+    bool compress(const std::string& data, std::string& output)
+    {
+        //each message is compressed independently of the previous ones, so that it can be shared by all the connections
+        if(!initialized || deflateReset(&stream) != Z_OK)
+        {
+            return false;
+        }
+
+        output.resize(deflateBound(&stream, data.size()) + 16);
+        stream.next_in = (Bytef*)data.data();
+        stream.avail_in = data.size();
+        stream.next_out = (Bytef*)&output[0];
+        stream.avail_out = output.size();
+
+        if(deflate(&stream, Z_SYNC_FLUSH) != Z_OK || stream.avail_in != 0 || stream.avail_out == 0)
+        {
+            return false;
+        }
+        output.resize(output.size() - stream.avail_out);
+
+        //the message ends with the empty block 00 00 ff ff of the sync flush, which is removed (RFC 7692 section 7.2.1)
+        if(output.size() < 4 || output.compare(output.size()-4, 4, "\x00\x00\xff\xff", 4) != 0)
+        {
+            return false;
+        }
+        output.resize(output.size()-4);
+        return true;
+    }
+
+private:
+    z_stream stream;
+    bool initialized;
+};
+}
+
+WebInterface::frame_ptr WebInterface::makeFrame(const string &payload, websocketpp::frame::opcode::value op)
+{
+    auto frame = std::make_shared<SharedFrame>();
+    prepareFrame(*frame, payload, op);
+
+    //the json messages are encoded once for all the clients of each codec in use
+    unsigned int active = activeCodecs.load(std::memory_order_relaxed);
+    if(active != 0 && op == websocketpp::frame::opcode::text)
+    {
+        frame->encoded.resize(codecs.size());
+        for(size_t i = 1; i<codecs.size(); i++)
+        {
+            if(active & (1u << i))
+            {
+                frame->encoded[i] = makeEncodedFrame(payload, i);
+            }
+        }
+    }
+
+    return frame;
+}
+
+void WebInterface::prepareFrame(SharedFrame &frame, const string &payload, websocketpp::frame::opcode::value op)
+{
+    frame.plain = makePreparedMessage(payload, op, false);
+
+    if(compressionEnabled.load(std::memory_order_relaxed) && payload.size() >= compressionThreshold.load(std::memory_order_relaxed))
+    {
+        static thread_local MessageDeflater deflater;
+        static thread_local std::string compressed;
+        if(deflater.compress(payload, compressed) && compressed.size() < payload.size())
+        {
+            frame.deflated = makePreparedMessage(compressed, op, true);
+        }
+    }
+}
+
+WebInterface::frame_ptr WebInterface::makeEncodedFrame(const string &json, size_t codec)
+{
+    static thread_local std::string encoded;
+    if(!codecs[codec]->encode(json, encoded))
+    {
+        m_endpoint.get_alog().write(websocketpp::log::alevel::app, "message not encoded with "+codecs[codec]->getSubprotocol());
+        return frame_ptr();
+    }
+
+    auto frame = std::make_shared<SharedFrame>();
+    prepareFrame(*frame, encoded, codecs[codec]->isBinary() ? websocketpp::frame::opcode::binary : websocketpp::frame::opcode::text);
+    return frame;
+}
+
+WebInterface::message_ptr WebInterface::makePreparedMessage(const string &payload, websocketpp::frame::opcode::value op, bool compressed)
+{
+    auto message = m_msgManager->get_message(op, payload.size());
+
+    // server frames are never masked, the RSV1 bit marks a compressed message
+    websocketpp::frame::basic_header header(op, payload.size(), true, false, compressed);
+    websocketpp::frame::extended_header extendedHeader(payload.size());
+    message->set_header(websocketpp::frame::prepare_header(header,extendedHeader));
+    message->set_payload(payload);
+    message->set_prepared(true);
+
+    return message;
+}
+
+WebInterface::PendingSend WebInterface::makeSend(WebInterface::connection_hdl hdl, frame_ptr frame)
+{
+    auto con = m_connections.find(hdl);
+    if(con == m_connections.end())
+    {
+        return PendingSend{hdl, frame, true, false, 0, nullptr, 0};
+    }
+    return makeSend(*con, frame);
+}
+
+WebInterface::PendingSend WebInterface::makeSend(const con_list::value_type &connection, frame_ptr frame)
+{
+    return PendingSend{connection.first, frame, connection.second.acceptsPreparedFrames, connection.second.acceptsDeflate, connection.second.codec,
+                connection.second.traffic, 0};
+}
+
+void WebInterface::setCompression(bool enabled, size_t threshold)
+{
+    compressionThreshold.store(threshold, std::memory_order_relaxed);
+    compressionEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+void WebInterface::setBinaryQuantization(bool enabled)
+{
+    binaryQuantization = enabled;
+}
+
+bool WebInterface::addWireCodec(std::shared_ptr<const WireCodec> codec)
+{
+    if(codecs.size() >= 32)
+    {
+        return false;
+    }
+    codecs.push_back(codec);
+    codecConnectionCounts.push_back(0);
+    return true;
+}
+
+void WebInterface::sendFrame(const PendingSend &send)
+{
+    frame_ptr frame = send.frame;
+    if(frame && send.codec != 0 && frame->plain->get_opcode() == websocketpp::frame::opcode::text)
+    {
+        if(send.codec < frame->encoded.size() && frame->encoded[send.codec])
+        {
+            frame = frame->encoded[send.codec];
+        }
+        else
+        {
+            //the frame was built before the first client of the codec connected
+            frame = makeEncodedFrame(frame->plain->get_payload(), send.codec);
+        }
+    }
+    if(!frame)
+    {
+        return;
+    }
+
+    websocketpp::lib::error_code ec;
+    size_t size;
+
+    if(send.acceptsDeflate && frame->deflated)
+    {
+        m_endpoint.send(send.hdl,frame->deflated,ec);
+        size = frame->deflated->get_payload().size();
+    }
+    else if(send.acceptsPreparedFrames)
+    {
+        m_endpoint.send(send.hdl,frame->plain,ec);
+        size = frame->plain->get_payload().size();
+    }
+    else
+    {
+        m_endpoint.send(send.hdl,frame->plain->get_payload(),frame->plain->get_opcode(),ec);
+        size = frame->plain->get_payload().size();
+    }
+
+    if(ec)
+    {
+        m_endpoint.get_alog().write(websocketpp::log::alevel::app, "send failed: "+ec.message());
+        return;
+    }
+    traffic.addSent(size);
+    if(send.traffic)
+    {
+        send.traffic->addSent(size);
+    }
+}
+
+void WebInterface::collectFrame(frame_ptr frame, SendList &sends)
+{
+    for(auto& it: m_connections)
+    {
+        sends.push_back(makeSend(it, frame));
+    }
+}
+
+void WebInterface::addCommand(const std::string &command)
+{
+    ReceivedCommand received;
+    received.isElementUpdate = false;
+    received.text.assign(command);
+    received.received = messageReceived;
+    deliverCommand(received);
+}
+
+void WebInterface::pushCommand(const ReceivedCommand &command)
+{
+    if(!commandQueue.push(command))
+    {
+        m_endpoint.get_alog().write(websocketpp::log::alevel::app, "command queue full, command dropped");
+        return;
+    }
+    notifyCommands();
+}
+
+void WebInterface::notifyCommands()
+{
+    //pairs with the fence of waitForCommands(): either the program sees the command, or the command sees the program waiting
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(waitingForCommands.load(std::memory_order_relaxed))
+    {
+        //the program is either before its wait (and will see the command) or waiting
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+        }
+        commandSignal.notify_one();
+    }
+
+    int fd = commandFd.load(std::memory_order_acquire);
+    if(fd >= 0 && !commandFdSignaled.exchange(true))
+    {
+        signalCommandFd(fd);
+    }
+}
+
+void WebInterface::signalCommandFd(int fd)
+{
+#ifdef __linux__
+    uint64_t one = 1;
+    //can only fail if the counter is full, in which case the descriptor is readable anyway
+    ssize_t written = write(fd, &one, sizeof(one));
+    (void)written;
+#endif
+}
+
+bool WebInterface::waitForCommands(std::chrono::milliseconds timeout)
+{
+    if(!threaded)
+    {
+        return false;
+    }
+
+    std::unique_lock<std::mutex> lock(commandMutex);
+    waitingForCommands.store(true, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    commandSignal.wait_for(lock, timeout, [this]{ return commandQueue.size() > 0 || m_stopped; });
+    waitingForCommands.store(false, std::memory_order_relaxed);
+    return commandQueue.size() > 0;
+}
+
+int WebInterface::getCommandFd()
+{
+#ifdef __linux__
+    int fd = commandFd.load(std::memory_order_acquire);
+    if(fd >= 0)
+    {
+        return fd;
+    }
+    fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd < 0)
+    {
+        std::cout<<"InstantInterface::WebInterface::getCommandFd(), couldn't create the eventfd."<<std::endl;
+        return -1;
+    }
+    commandFd.store(fd, std::memory_order_release);
+
+    //the commands received before are signaled as well
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if(commandQueue.size() > 0 && !commandFdSignaled.exchange(true))
+    {
+        signalCommandFd(fd);
+    }
+    return fd;
+#else
+    return -1;
+#endif
+}
+
+void WebInterface::parseCommand(connection_hdl hdl, const string &content)
+{
+    Json::Reader reader;
+    Json::Value messageJson;
+    if(!reader.parse(content, messageJson))
+    {
+        //left to executeSingleCommand()
+        addCommand(content);
+        return;
+    }
+    parseCommand(hdl, messageJson, content);
+}
+
+void WebInterface::parseCommand(connection_hdl hdl, const Json::Value &messageJson, const string &content)
+{
+    structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+    const std::shared_ptr<const ElementHandleMap>& handles = structure->elementHandles;
+    uint64_t generation = structure->handleGeneration;
+
+    if(!handles || !messageJson.isObject() || messageJson["type"].asString() != "update")
+    {
+        //left to executeSingleCommand()
+        if(content.empty())
+        {
+            Json::FastWriter writer;
+            addCommand(writer.write(messageJson));
+        }
+        else
+        {
+            addCommand(content);
+        }
+        return;
+    }
+
+    //one reusable command per thread of the server
+    static thread_local ReceivedCommand received;
+    received.isElementUpdate = true;
+    received.update.handleGeneration = generation;
+    received.origin = hdl;
+    //sequence number of the edit, acknowledged to the client once its values have been broadcast
+    const Json::Value& seq = messageJson["seq"];
+    received.seq = seq.isUInt64() ? seq.asUInt64() : 0;
+    received.received = messageReceived;
+    //optional time of the edit on the client, for measuring the latency from end to end
+    const Json::Value& clientTime = messageJson["t"];
+    received.clientTime = clientTime.isNumeric() ? clientTime.asDouble() : 0;
+
+    const Json::Value& updates = messageJson["content"];
+    for(Json::ValueConstIterator itr = updates.begin(); itr != updates.end(); itr++)
+    {
+        const std::string paramId = (*itr)["id"].asString();
+        auto handle = handles->find(paramId);
+        if(handle == handles->end())
+        {
+            std::cout<<"There is no attribute named "<<paramId<<" in the attribute map."<<std::endl;
+            continue;
+        }
+
+        received.update.handle = handle->second.index;
+        if(!convertValue((*itr)["value"], handle->second.type, received.update))
+        {
+            std::cout<<"Invalid value received for "<<paramId<<"."<<std::endl;
+            continue;
+        }
+        deliverCommand(received);
+    }
+}
+
+void WebInterface::parseBinaryCommand(connection_hdl hdl, const string &payload)
+{
+    structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+    const std::shared_ptr<const std::vector<TypeValue> >& types = structure->handleTypes;
+    uint64_t generation = structure->handleGeneration;
+
+    BinaryReader reader(payload);
+    uint8_t messageType;
+    if(!types || !reader.uint8(messageType))
+    {
+        std::cout<<"Couldn't parse received binary message."<<std::endl;
+        return;
+    }
+
+    //one reusable command per thread of the server
+    static thread_local ReceivedCommand received;
+    received.isElementUpdate = true;
+    received.update.handleGeneration = generation;
+    received.origin = hdl;
+    received.seq = 0;
+    received.received = messageReceived;
+    received.clientTime = 0;
+
+    uint32_t handle;
+    if(messageType == BinaryProtocol::MESSAGE_ACTION)
+    {
+        if(!reader.uint32(handle))
+        {
+            std::cout<<"Couldn't parse received binary message."<<std::endl;
+            return;
+        }
+        received.update.handle = handle;
+        received.update.type = TYPE_UNDEFINED;
+        deliverCommand(received);
+        return;
+    }
+    if(messageType != BinaryProtocol::MESSAGE_UPDATE)
+    {
+        std::cout<<"Unknown binary message type "<<(int)messageType<<"."<<std::endl;
+        return;
+    }
+
+    while(!reader.atEnd())
+    {
+        uint8_t tag;
+        bool valid;
+        if(!reader.uint32(handle) || !reader.uint8(tag) ||
+                !readBinaryValue(reader, tag, handle < types->size() ? (*types)[handle] : TYPE_UNDEFINED, received.update, valid))
+        {
+            //the records have no fixed size, so nothing can be read after an invalid one
+            std::cout<<"Couldn't parse received binary message."<<std::endl;
+            return;
+        }
+        if(handle >= types->size() || !valid)
+        {
+            std::cout<<"Invalid value received for the element handle "<<handle<<"."<<std::endl;
+            continue;
+        }
+        received.update.handle = handle;
+        deliverCommand(received);
+    }
+}
+
+bool WebInterface::readBinaryValue(BinaryReader &reader, uint8_t tag, TypeValue type, ElementUpdate &update, bool &valid)
+{
+    //the numbers are converted to the type of the element, like the json values
+    double number = 0;
+    switch (tag) {
+    case BinaryProtocol::TAG_BOOL:
+    {
+        uint8_t v;
+        if(!reader.uint8(v))
+        {
+            return false;
+        }
+        number = v;
+        break;
+    }
+    case BinaryProtocol::TAG_INT:
+    {
+        uint32_t v;
+        if(!reader.uint32(v))
+        {
+            return false;
+        }
+        number = (int32_t)v;
+        break;
+    }
+    case BinaryProtocol::TAG_FLOAT:
+    {
+        float v;
+        if(!reader.float32(v))
+        {
+            return false;
+        }
+        number = v;
+        break;
+    }
+    case BinaryProtocol::TAG_DOUBLE:
+        if(!reader.float64(number))
+        {
+            return false;
+        }
+        break;
+    case BinaryProtocol::TAG_STRING:
+        if(!reader.string(update.stringValue))
+        {
+            return false;
+        }
+        break;
+    default:
+        return false;
+    }
+
+    update.type = type;
+    valid = (tag == BinaryProtocol::TAG_STRING) == (type == TYPE_STRING) || type == TYPE_UNDEFINED;
+    switch (type) {
+    case TYPE_BOOL:
+        update.boolValue = number != 0;
+        break;
+    case TYPE_INT:
+        update.intValue = (int)number;
+        break;
+    case TYPE_FLOAT:
+        update.floatValue = (float)number;
+        break;
+    case TYPE_DOUBLE:
+        update.doubleValue = number;
+        break;
+    default:
+        //string already read, or action whose value is ignored
+        break;
+    }
+    return true;
+}
+
+void WebInterface::deliverCommand(ReceivedCommand &command)
+{
+    command.queued = std::chrono::steady_clock::now();
+    if(threaded)
+    {
+        pushCommand(command);
+    }
+    else
+    {
+        //we are in the thread of the program
+        command.dequeued = command.queued;
+        executeCommand(command);
+    }
+}
+
+bool WebInterface::convertValue(const Json::Value &value, TypeValue type, ElementUpdate &update)
+{
+    update.type = type;
+    switch (type) {
+    case TYPE_BOOL:
+        if(!value.isConvertibleTo(Json::booleanValue))
+        {
+            return false;
+        }
+        update.boolValue = value.asBool();
+        return true;
+    case TYPE_INT:
+        if(!value.isConvertibleTo(Json::intValue))
+        {
+            return false;
+        }
+        update.intValue = value.asInt();
+        return true;
+    case TYPE_FLOAT:
+        if(!value.isConvertibleTo(Json::realValue))
+        {
+            return false;
+        }
+        update.floatValue = value.asFloat();
+        return true;
+    case TYPE_DOUBLE:
+        if(!value.isConvertibleTo(Json::realValue))
+        {
+            return false;
+        }
+        update.doubleValue = value.asDouble();
+        return true;
+    case TYPE_STRING:
+        if(!value.isConvertibleTo(Json::stringValue))
+        {
+            return false;
+        }
+        update.stringValue = value.asString();
+        return true;
+    default:
+        //action, the value is ignored
+        return true;
+    }
+}
+
+void WebInterface::executeCommands()
+{
+    DurationCounter::Scope timer(executeDurations);
+
+    //the descriptor is reset before reading the queue, so that a command pushed meanwhile signals it again. It is always drained,
+    //since a notification can be written after its flag has been set (reading an empty eventfd only fails with EAGAIN)
+    int fd = commandFd.load(std::memory_order_acquire);
+    if(fd >= 0)
+    {
+#ifdef __linux__
+        uint64_t count;
+        ssize_t read = ::read(fd, &count, sizeof(count));
+        (void)read;
+#endif
+        commandFdSignaled.store(false);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    //the commands received while executing are left for the next call, so that a flood of messages can't block the program
+    size_t count = commandQueue.size();
+
+    if(!coalesceUpdates)
+    {
+        while(count-- > 0 && commandQueue.pop(commandBuffer))
+        {
+            commandBuffer.dequeued = std::chrono::steady_clock::now();
+            executeCommand(commandBuffer);
+        }
+        return;
+    }
+
+    //the pending commands are collected first, so that only the last value of each attribute is applied
+    if(pendingCommands.size() < count)
+    {
+        pendingCommands.resize(count);
+    }
+    size_t n = 0;
+    while(n < count && commandQueue.pop(pendingCommands[n]))
+    {
+        n++;
+    }
+
+    lastUpdates.clear();
+    for(size_t i = 0; i<n; i++)
+    {
+        const ReceivedCommand& command = pendingCommands[i];
+        if(command.isElementUpdate && command.update.type != TYPE_UNDEFINED)
+        {
+            lastUpdates[command.update.handle] = i;
+        }
+    }
+
+    for(size_t i = 0; i<n; i++)
+    {
+        ReceivedCommand& command = pendingCommands[i];
+        //the actions and the text commands are all executed in order, the values superseded by a later value are skipped
+        if(command.isElementUpdate && command.update.type != TYPE_UNDEFINED)
+        {
+            auto last = lastUpdates.find(command.update.handle);
+            if(last->second != i && pendingCommands[last->second].update.handleGeneration == command.update.handleGeneration)
+            {
+                //the edit is still acknowledged, since its value has been superseded
+                recordSequence(command);
+                coalescedCount++;
+                continue;
+            }
+        }
+        //the time spent waiting for the commands before it in the batch is counted as queueing, not as its execution
+        command.dequeued = std::chrono::steady_clock::now();
+        executeCommand(command);
+    }
+}
+
+void WebInterface::executeCommand(const ReceivedCommand &command)
+{
+    if(command.isElementUpdate)
+    {
+        if(applyElementUpdate(command.update) && deltaRefresh && command.update.type != TYPE_UNDEFINED)
+        {
+            //the client that sent the value doesn't need it back, unless the value is changed again before the broadcast
+            EchoRecord& echo = echoes[command.update.handle];
+            echo.origin = command.origin;
+            echo.handleGeneration = command.update.handleGeneration;
+            echo.polledVersion = 0;
+            writeValueJson(command.update, echo.valueJson);
+        }
+        recordSequence(command);
+    }
+    else
+    {
+        executeSingleCommand(command.text);
+    }
+    recordLatencies(command);
+}
+
+void WebInterface::recordLatencies(const ReceivedCommand &command)
+{
+    if(command.received == std::chrono::steady_clock::time_point())
+    {
+        //not received from a client
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    latencies[LATENCY_PARSE].record(command.queued - command.received);
+    latencies[LATENCY_QUEUE].record(command.dequeued - command.queued);
+    latencies[LATENCY_APPLY].record(now - command.dequeued);
+    latencies[LATENCY_TOTAL].record(now - command.received);
+    if(command.clientTime > 0)
+    {
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::system_clock::now().time_since_epoch()).count();
+        if(milliseconds >= command.clientTime)
+        {
+            latencies[LATENCY_CLIENT].recordNanoseconds((uint64_t)((milliseconds - command.clientTime)*1e6));
+        }
+    }
+}
+
+const LatencyHistogram &WebInterface::getLatencyHistogram(LatencyStage stage) const
+{
+    return latencies[stage];
+}
+
+void WebInterface::dumpLatencies(ostream &stream) const
+{
+    for(int i = 0; i<LATENCY_STAGE_COUNT; i++)
+    {
+        stream<<latencyStageNames[i]<<": ";
+        latencies[i].dump(stream);
+        stream<<std::endl;
+    }
+}
+
+void WebInterface::resetLatencies()
+{
+    for(auto& histogram: latencies)
+    {
+        histogram.reset();
+    }
+}
+
+void WebInterface::recordSequence(const ReceivedCommand &command)
+{
+    if(command.seq == 0)
+    {
+        return;
+    }
+    uint64_t& seq = receivedSequences[command.origin];
+    seq = std::max(seq, command.seq);
+}
+
+void WebInterface::writeValueJson(const ElementUpdate &update, string &buffer)
+{
+    //same serialization as the values polled by pollStateChanges(), so that both can be compared
+    buffer.clear();
+    JsonWriter writer(buffer);
+    switch (update.type) {
+    case TYPE_BOOL:
+        writer.value(update.boolValue);
+        break;
+    case TYPE_INT:
+        writer.value(update.intValue);
+        break;
+    case TYPE_FLOAT:
+        writer.value(update.floatValue);
+        break;
+    case TYPE_DOUBLE:
+        writer.value(update.doubleValue);
+        break;
+    case TYPE_STRING:
+        writer.value(update.stringValue);
+        break;
+    default:
+        writer.valueNull();
+        break;
+    }
+}
+
+bool WebInterface::findEchoOrigin(uint64_t since, connection_hdl &origin)
+{
+    getChangedElements(changedElements, since);
+    if(changedElements.empty())
+    {
+        return false;
+    }
+
+    //all the changes must come from the same client, with the values it has sent
+    uint64_t generation = getHandleGeneration();
+    for(size_t i = 0; i<changedElements.size(); i++)
+    {
+        auto echo = echoes.find(changedElements[i]);
+        if(echo == echoes.end() || echo->second.handleGeneration != generation ||
+                echo->second.valueJson != getPolledValueJson(changedElements[i]))
+        {
+            return false;
+        }
+        if(i == 0)
+        {
+            origin = echo->second.origin;
+        }
+        else if(origin.owner_before(echo->second.origin) || echo->second.origin.owner_before(origin))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void WebInterface::collectAcknowledgements(SendList &sends)
+{
+    for(auto& it: m_connections)
+    {
+        //the edits of a lagging client are acknowledged when it catches up, see collectPendingBroadcasts()
+        if(!it.second.structurePending && !it.second.valuesPending)
+        {
+            collectAcknowledgement(it, sends);
+        }
+    }
+}
+
+void WebInterface::collectAcknowledgement(con_list::value_type &connection, SendList &sends)
+{
+    if(connection.second.pendingAck != 0)
+    {
+        sends.push_back(makeSend(connection, makeFrame("{\"type\":\"ack\",\"seq\":" + std::to_string(connection.second.pendingAck) + "}")));
+        connection.second.pendingAck = 0;
+    }
+}
+
+void WebInterface::setUpdateCoalescing(bool enabled)
+{
+    coalesceUpdates = enabled;
+}
+
+uint64_t WebInterface::getCoalescedUpdateCount() const
+{
+    return coalescedCount;
+}
+
+size_t WebInterface::getCommandQueueDepth() const
+{
+    return commandQueue.size();
+}
+
+uint64_t WebInterface::getCommandOverflowCount() const
+{
+    return commandQueue.getOverflowCount();
+}
+
+bool WebInterface::executeSingleCommand(const string &content)
+{
+    Json::Reader reader;
+    Json::Value messageJson;
+    bool success = reader.parse(content.c_str(), messageJson);
+    if(!success)
+    {
+        std::cout<<"Couldn't parse received message to json."<<std::endl;
+        return false;
+    }
+
+    if(messageJson["type"].asString()=="update")
+    {
+        Json::Value updates = messageJson["content"];
+        for(Json::ValueIterator itr = updates.begin(); itr != updates.end(); itr++)
+        {
+            std::string paramId = (*itr)["id"].asString();
+            updateInterfaceElement(paramId,(*itr)["value"]);
+        }
+        return true;
+    }
+
+    return false;
+}
+
+void WebInterface::updateStructureCache()
+{
+    DurationCounter::Scope timer(structureCacheDurations);
+
+    //the snapshot is built without lock and published atomically, the threads of the server keep sending the previous one meanwhile
+    auto snapshot = std::make_shared<StructureSnapshot>();
+    writeStructureJson(structureBuffer, false);
+    snapshot->groupPaths = getGroupPaths();
+    auto handles = std::make_shared<ElementHandleMap>();
+    snapshot->handleGeneration = getElementHandles(*handles);
+    snapshot->revision = getStructureRevision();
+    auto types = std::make_shared<std::vector<TypeValue> >(handles->size(), TYPE_UNDEFINED);
+    for(const auto& it: *handles)
+    {
+        (*types)[it.second.index] = it.second.type;
+    }
+    snapshot->elementHandles = handles;
+    snapshot->handleTypes = types;
+    snapshot->generation = ++structureGeneration;
+
+    //FNV-1a hash of the structure without the values, which identifies it for the clients reconnecting
+    uint64_t hashValue = 14695981039346656037ULL;
+    for(unsigned char c: structureBuffer)
+    {
+        hashValue ^= c;
+        hashValue *= 1099511628211ULL;
+    }
+    char hash[17];
+    snprintf(hash, sizeof(hash), "%016llx", (unsigned long long)hashValue);
+    snapshot->hash = hash;
+
+    structure_snapshot_ptr previous = std::atomic_load(&structureSnapshot);
+    if(previous->hash == snapshot->hash)
+    {
+        //the clients already have this structure, but the handles are always replaced, since they may have changed
+        snapshot->structure = previous->structure;
+        snapshot->unchanged = previous->unchanged;
+        snapshot->patch = previous->patch;
+        snapshot->patchBaseHash = previous->patchBaseHash;
+        std::atomic_store(&structureSnapshot, structure_snapshot_ptr(snapshot));
+        return;
+    }
+
+    //the clients that have the last broadcast structure only receive the edits made since then
+    structure_snapshot_ptr base = std::atomic_load(&broadcastStructureSnapshot);
+    if(!base->hash.empty() && writeStructurePatchJson(patchBuffer, base->revision))
+    {
+        patchBuffer.pop_back();
+        patchBuffer.append(",\"base\":\"").append(base->hash).append("\",\"hash\":\"").append(hash).append("\"}");
+        snapshot->patch = makeFrame(patchBuffer);
+        snapshot->patchBaseHash = base->hash;
+    }
+
+    //the hash is added to the message (the structure message is a json object ending with '}')
+    writeStructureJson(structureBuffer);
+    structureBuffer.pop_back();
+    structureBuffer.append(",\"hash\":\"").append(hash).append("\",\"session\":\"").append(sessionId).append("\"}");
+    snapshot->structure = makeFrame(structureBuffer);
+    snapshot->unchanged = makeFrame(std::string("{\"type\":\"unchanged\",\"hash\":\"") + hash + "\",\"session\":\"" + sessionId + "\"}");
+
+    std::atomic_store(&structureSnapshot, structure_snapshot_ptr(snapshot));
+}
+
+void WebInterface::updateParameterCache()
+{
+    DurationCounter::Scope timer(parameterCacheDurations);
+
+    //the snapshot is built without lock and published atomically, so that the program never waits for the network
+    std::shared_ptr<ValuesSnapshot> snapshot = recycleValuesSnapshot();
+
+    //in delta mode, the messages are tagged with the version of the state
+    uint64_t version = deltaRefresh ? pollStateChanges() : 0;
+    uint64_t since = lastRefreshVersion;
+    snapshot->version = version;
+    snapshot->since = since;
+
+    //the values are serialized group by group, so that the messages of the clients with subscriptions can be assembled from the same fragments
+    writeStateJsonByGroup(snapshot->valueFragments);
+    if(allGroups.size() != snapshot->valueFragments.size())
+    {
+        allGroups.assign(snapshot->valueFragments.size(), true);
+    }
+    assembleUpdate(valuesBuffer, snapshot->valueFragments, allGroups, version);
+    snapshot->values = makeFrame(valuesBuffer);
+
+    bool withBinary = binaryConnectionCount > 0;
+    if(withBinary)
+    {
+        writeStateBinaryByGroup(snapshot->binaryValueFragments, binaryQuantization);
+        assembleBinaryUpdate(binaryValuesBuffer, snapshot->binaryValueFragments, allGroups);
+        snapshot->binaryValues = makeFrame(binaryValuesBuffer, websocketpp::frame::opcode::binary);
+    }
+
+    if(deltaRefresh)
+    {
+        //the edits whose values have already been broadcast are forgotten
+        for(auto it = echoes.begin(); it != echoes.end();)
+        {
+            if(it->second.polledVersion == 0)
+            {
+                it->second.polledVersion = version;
+            }
+            if(it->second.polledVersion <= since)
+            {
+                it = echoes.erase(it);
+            }
+            else
+            {
+                it++;
+            }
+        }
+        snapshot->echoOnly = findEchoOrigin(since, snapshot->echoOrigin);
+
+        //the delta is computed from the last broadcast version, so that the changes are accumulated until the next broadcast
+        if(writeStateDeltaJsonByGroup(snapshot->deltaFragments, since))
+        {
+            assembleUpdate(deltaBuffer, snapshot->deltaFragments, allGroups, version);
+            snapshot->delta = makeFrame(deltaBuffer);
+        }
+        if(withBinary && writeStateDeltaBinaryByGroup(snapshot->binaryDeltaFragments, since, binaryQuantization))
+        {
+            assembleBinaryUpdate(binaryDeltaBuffer, snapshot->binaryDeltaFragments, allGroups);
+            snapshot->binaryDelta = makeFrame(binaryDeltaBuffer, websocketpp::frame::opcode::binary);
+        }
+    }
+
+    //the edits are published before the values which contain them (see takeAcknowledgements())
+    if(!receivedSequences.empty())
+    {
+        std::lock_guard<std::mutex> lock(acknowledgementsMutex);
+        for(auto& it: receivedSequences)
+        {
+            uint64_t& seq = publishedSequences[it.first];
+            seq = std::max(seq, it.second);
+        }
+    }
+    receivedSequences.clear();
+
+    std::atomic_store(&valuesSnapshot, values_snapshot_ptr(snapshot));
+}
+
+std::shared_ptr<WebInterface::ValuesSnapshot> WebInterface::recycleValuesSnapshot()
+{
+    //the published snapshot, the broadcast one and the ones still being sent
+    const size_t poolSize = 4;
+
+    for(auto& snapshot: valuesSnapshotPool)
+    {
+        if(snapshot.use_count() == 1)
+        {
+            //only the pool holds it, so no thread can reach it anymore. The fence orders the reads of the thread that has released it
+            //before the writes that follow
+            std::atomic_thread_fence(std::memory_order_acquire);
+            snapshot->values.reset();
+            snapshot->delta.reset();
+            snapshot->binaryValues.reset();
+            snapshot->binaryDelta.reset();
+            //the fragments that are not written again must not be assembled, but their memory is kept
+            for(auto fragments: {&snapshot->valueFragments, &snapshot->deltaFragments, &snapshot->binaryValueFragments, &snapshot->binaryDeltaFragments})
+            {
+                for(auto& fragment: *fragments)
+                {
+                    fragment.clear();
+                }
+            }
+            snapshot->version = 0;
+            snapshot->since = 0;
+            snapshot->echoOrigin.reset();
+            snapshot->echoOnly = false;
+            return snapshot;
+        }
+    }
+
+    auto snapshot = std::make_shared<ValuesSnapshot>();
+    if(valuesSnapshotPool.size() < poolSize)
+    {
+        valuesSnapshotPool.push_back(snapshot);
+    }
+    return snapshot;
+}
+
+void WebInterface::broadcastValues()
+{
+    auto start = std::chrono::steady_clock::now();
+    SendList sends;
+    SubscriptionList subscriptions;
+    values_snapshot_ptr values;
+    {
+        scoped_lock lock(parametersMutex);
+        takeAcknowledgements();
+        //a client ignores the values of its edits until they are acknowledged, so the acknowledgements go first
+        collectAcknowledgements(sends);
+        values = std::atomic_load(&valuesSnapshot);
+        structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+        if(values != broadcastValuesSnapshot)
+        {
+            refreshCount++;
+            if(deltaRefresh && (fullRefreshPeriod == 0 || refreshCount < fullRefreshPeriod))
+            {
+                //no delta frame means that nothing has changed
+                if(values->delta)
+                {
+                    collectUpdates(*values, *structure, true, sends, subscriptions);
+                }
+            }
+            else
+            {
+                //periodic full refresh, in case a client missed something
+                collectUpdates(*values, *structure, false, sends, subscriptions);
+                refreshCount = 0;
+            }
+            recordResumeDelta(*values);
+            broadcastValuesSnapshot = values;
+            lastRefreshVersion = values->version;
+        }
+        //the clients that have skipped broadcasts catch up, even if nothing has changed since
+        collectPendingBroadcasts(*values, *structure, sends, subscriptions);
+    }
+
+    //the messages of the clients with subscriptions are assembled after releasing the lock
+    assembleSubscriptions(*values, subscriptions, sends);
+    for(auto& send: sends)
+    {
+        sendFrame(send);
+    }
+    closeLaggingConnections();
+    if(!sends.empty())
+    {
+        broadcastDurations.add(std::chrono::steady_clock::now() - start);
+    }
+}
+
+void WebInterface::takeAcknowledgements()
+{
+    std::map<connection_hdl, uint64_t, std::owner_less<connection_hdl> > sequences;
+    {
+        std::lock_guard<std::mutex> lock(acknowledgementsMutex);
+        sequences.swap(publishedSequences);
+    }
+    for(auto& it: sequences)
+    {
+        auto con = m_connections.find(it.first);
+        if(con != m_connections.end())
+        {
+            con->second.pendingAck = std::max(con->second.pendingAck, it.second);
+        }
+    }
+}
+
+void WebInterface::recordResumeDelta(const ValuesSnapshot &values)
+{
+    if(resumeCapacity == 0)
+    {
+        return;
+    }
+    if(resumeLog.empty() && resumeBaseVersion == std::numeric_limits<uint64_t>::max())
+    {
+        //all the changes made after this version are logged from now on
+        resumeBaseVersion = values.since;
+    }
+    if(!values.delta)
+    {
+        return;
+    }
+    resumeLog.push_back(ResumeRecord{values.since, values.version, values.delta, values.binaryDelta});
+    while(resumeLog.size() > resumeCapacity)
+    {
+        //the clients older than the forgotten delta can't catch up anymore
+        resumeBaseVersion = resumeLog.front().version;
+        resumeLog.pop_front();
+    }
+}
+
+void WebInterface::setResumeCapacity(size_t count)
+{
+    scoped_lock lock(parametersMutex);
+    resumeCapacity = count;
+    while(resumeLog.size() > resumeCapacity)
+    {
+        resumeBaseVersion = resumeLog.front().version;
+        resumeLog.pop_front();
+    }
+    if(resumeCapacity == 0)
+    {
+        resumeBaseVersion = std::numeric_limits<uint64_t>::max();
+    }
+}
+
+WebInterface::Metrics WebInterface::getMetrics()
+{
+    Metrics metrics;
+    metrics.messagesReceived = traffic.messagesReceived;
+    metrics.bytesReceived = traffic.bytesReceived;
+    metrics.messagesSent = traffic.messagesSent;
+    metrics.bytesSent = traffic.bytesSent;
+    metrics.httpRequests = httpRequests;
+    metrics.connectionsOpened = connectionsOpened;
+    metrics.connectionsClosed = connectionsClosed;
+    metrics.commandQueueDepth = commandQueue.size();
+    metrics.commandQueueCapacity = commandQueue.capacity();
+    metrics.droppedCommands = commandQueue.getOverflowCount();
+    metrics.executeCommands = TaskDurations{executeDurations.getCount(), executeDurations.getSeconds()};
+    metrics.updateParameterCache = TaskDurations{parameterCacheDurations.getCount(), parameterCacheDurations.getSeconds()};
+    metrics.updateStructureCache = TaskDurations{structureCacheDurations.getCount(), structureCacheDurations.getSeconds()};
+    metrics.broadcast = TaskDurations{broadcastDurations.getCount(), broadcastDurations.getSeconds()};
+
+    scoped_lock lock(parametersMutex);
+    metrics.deferredBroadcasts = deferredBroadcastCount;
+    for(auto& it: m_connections)
+    {
+        const ConnectionData& data = it.second;
+        Metrics::Connection connection;
+        connection.id = data.id;
+        connection.subprotocol = data.connection ? data.connection->get_subprotocol() : std::string();
+        connection.messagesReceived = data.traffic->messagesReceived;
+        connection.bytesReceived = data.traffic->bytesReceived;
+        connection.messagesSent = data.traffic->messagesSent;
+        connection.bytesSent = data.traffic->bytesSent;
+        connection.bufferedBytes = data.connection ? data.connection->get_buffered_amount() : 0;
+        metrics.connections.push_back(connection);
+    }
+    return metrics;
+}
+
+std::string WebInterface::getMetricsText()
+{
+    Metrics metrics = getMetrics();
+    std::string text;
+    PrometheusWriter writer(text);
+
+    writer.counter("instantinterface_messages_received_total", "Websocket messages received.", metrics.messagesReceived);
+    writer.counter("instantinterface_received_bytes_total", "Payload bytes of the websocket messages received.", metrics.bytesReceived);
+    writer.counter("instantinterface_messages_sent_total", "Websocket messages sent.", metrics.messagesSent);
+    writer.counter("instantinterface_sent_bytes_total", "Payload bytes of the websocket messages sent.", metrics.bytesSent);
+    writer.counter("instantinterface_http_requests_total", "Http requests served.", metrics.httpRequests);
+    writer.counter("instantinterface_connections_opened_total", "Websocket connections opened.", metrics.connectionsOpened);
+    writer.counter("instantinterface_connections_closed_total", "Websocket connections closed.", metrics.connectionsClosed);
+    writer.gauge("instantinterface_connections", "Websocket connections open.", metrics.connections.size());
+    writer.gauge("instantinterface_command_queue_depth", "Commands received and not executed yet.", metrics.commandQueueDepth);
+    writer.gauge("instantinterface_command_queue_capacity", "Capacity of the command queue.", metrics.commandQueueCapacity);
+    writer.counter("instantinterface_dropped_commands_total", "Commands dropped because the queue was full.", metrics.droppedCommands);
+    writer.counter("instantinterface_deferred_broadcasts_total", "Broadcasts not sent to a client because it was too slow.", metrics.deferredBroadcasts);
+    writer.durations("instantinterface_execute_commands", "Time spent in executeCommands().", executeDurations);
+    writer.durations("instantinterface_update_parameter_cache", "Time spent in updateParameterCache().", parameterCacheDurations);
+    writer.durations("instantinterface_update_structure_cache", "Time spent in updateStructureCache().", structureCacheDurations);
+    writer.durations("instantinterface_broadcast", "Time spent broadcasting the structure and the values.", broadcastDurations);
+
+    writer.header("instantinterface_command_latency_seconds", "Latency of the commands received from the clients, by stage.", "histogram");
+    for(int i = 0; i<LATENCY_STAGE_COUNT; i++)
+    {
+        writer.histogram("instantinterface_command_latency_seconds", latencies[i], std::string("stage=\"") + latencyStageNames[i] + "\"");
+    }
+
+    //traffic of the open connections, labelled by the number of the connection
+    const char* names[] = {"instantinterface_connection_messages_received_total", "instantinterface_connection_received_bytes_total",
+                           "instantinterface_connection_messages_sent_total", "instantinterface_connection_sent_bytes_total",
+                           "instantinterface_connection_buffered_bytes"};
+    const char* helps[] = {"Websocket messages received by the connection.", "Payload bytes received by the connection.",
+                           "Websocket messages sent to the connection.", "Payload bytes sent to the connection.",
+                           "Bytes waiting to be written to the connection."};
+    for(int i = 0; i<5; i++)
+    {
+        writer.header(names[i], helps[i], i < 4 ? "counter" : "gauge");
+        for(const Metrics::Connection& connection: metrics.connections)
+        {
+            uint64_t values[] = {connection.messagesReceived, connection.bytesReceived, connection.messagesSent, connection.bytesSent,
+                                 connection.bufferedBytes};
+            writer.sample(names[i], values[i], "connection=\"" + std::to_string(connection.id) + "\",subprotocol=\"" +
+                          PrometheusWriter::escapeLabel(connection.subprotocol) + "\"");
+        }
+    }
+    return text;
+}
+
+void WebInterface::setMetricsPath(const std::string &path)
+{
+    metricsPath = path;
+}
+
+void WebInterface::forceRefreshAll()
+{
+    updateParameterCache();
+    broadcastValues();
+}
+
+void WebInterface::setDeltaRefresh(bool enabled, unsigned int period)
+{
+    //broadcastValues() counts the refreshes in the thread of the server
+    scoped_lock lock(parametersMutex);
+    deltaRefresh = enabled;
+    fullRefreshPeriod = period;
+    refreshCount = 0;
+}
+
+bool WebInterface::broadcastStructure()
+{
+    auto start = std::chrono::steady_clock::now();
+    SendList sends;
+    SubscriptionList subscriptions;
+    values_snapshot_ptr values;
+    {
+        scoped_lock lock(parametersMutex);
+        structure_snapshot_ptr structure = std::atomic_load(&structureSnapshot);
+        if(structure->hash == broadcastStructureSnapshot->hash)
+        {
+            return false;
+        }
+
+        //each client receives the patch if it accepts patches and has the structure the patch applies to, the whole structure otherwise
+        for(auto& it: m_connections)
+        {
+            std::string& clientHash = it.second.structureHash;
+            if(clientHash == structure->hash || it.second.structurePending)
+            {
+                continue;
+            }
+            if(checkCongestion(it))
+            {
+                //the whole structure is sent once the client has caught up
+                it.second.structurePending = true;
+                deferredBroadcastCount++;
+                continue;
+            }
+            bool patch = structure->patch && it.second.acceptsPatches && clientHash == structure->patchBaseHash;
+            sends.push_back(makeSend(it, patch ? structure->patch : structure->structure));
+            clientHash = structure->hash;
+        }
+        std::atomic_store(&broadcastStructureSnapshot, structure);
+
+        //the clients need all the values after a new structure
+        takeAcknowledgements();
+        collectAcknowledgements(sends);
+        values = std::atomic_load(&valuesSnapshot);
+        collectUpdates(*values, *structure, false, sends, subscriptions);
+        collectPendingBroadcasts(*values, *structure, sends, subscriptions);
+        if(values != broadcastValuesSnapshot)
+        {
+            recordResumeDelta(*values);
+            broadcastValuesSnapshot = values;
+            lastRefreshVersion = values->version;
+        }
+    }
+
+    //the same frames are shared by all the connections
+    assembleSubscriptions(*values, subscriptions, sends);
+    for(auto& send: sends)
+    {
+        sendFrame(send);
+    }
+    closeLaggingConnections();
+    if(!sends.empty())
+    {
+        broadcastDurations.add(std::chrono::steady_clock::now() - start);
+    }
+    return true;
+}
+
+void WebInterface::forceRefreshStructureAll()
+{
+    updateStructureCache();
+    updateParameterCache();
+    if(!broadcastStructure())
+    {
+        //the structure hasn't changed, but the program expects the values to be refreshed
+        broadcastValues();
+    }
+}
+
+void WebInterface::setBroadcastRate(float valuesRate)
+{
+    long period = valuesRate > 0 ? std::max(1L, (long)(1000.0f / valuesRate)) : 0;
+
+    //the timer is only manipulated from the threads of the server, through the strand of the broadcasts
+    broadcastStrand->post([this, period]()
+    {
+        //a handler of the previous timer may already be queued, the generation enables to ignore it
+        broadcastGeneration++;
+        broadcastPeriod = period;
+        if(m_timer)
+        {
+            m_timer->cancel();
+            m_timer.reset();
+        }
+        if(broadcastPeriod > 0)
+        {
+            nextBroadcast = std::chrono::steady_clock::now();
+            scheduleBroadcast();
+        }
+    });
+}
+
+void WebInterface::scheduleBroadcast()
+{
+    nextBroadcast += std::chrono::milliseconds(broadcastPeriod);
+
+    //the deadlines are computed from the previous one, so that the broadcast rate doesn't drift
+    auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(nextBroadcast - std::chrono::steady_clock::now()).count();
+    if(delay < 0)
+    {
+        //we are late, we don't try to catch up the missed broadcasts
+        nextBroadcast = std::chrono::steady_clock::now();
+        delay = 0;
+    }
+
+    m_timer = m_endpoint.set_timer(delay, broadcastStrand->wrap(websocketpp::lib::bind(&WebInterface::on_broadcast_timer, this, broadcastGeneration, websocketpp::lib::placeholders::_1)));
+}
+
+void WebInterface::on_broadcast_timer(unsigned int generation, const websocketpp::lib::error_code &ec)
+{
+    if(ec || generation != broadcastGeneration || broadcastPeriod == 0)
+    {
+        //the timer has been cancelled or replaced
+        return;
+    }
+
+    if(!threaded)
+    {
+        //the timer is called from poll() or run(), in the thread of the program, so the attributes can be read directly
+        updateParameterCache();
+    }
+
+    if(!broadcastStructure())
+    {
+        broadcastValues();
+    }
+
+    scheduleBroadcast();
+}
+
+
+websocketpp::lib::error_code WebInterface::on_tcp_pre_bind(websocketpp::transport::asio::acceptor_ptr acceptor)
+{
+    //the acceptor is open, but not bound yet
+    scoped_lock lock(parametersMutex);
+    listenFd = (int)acceptor->native_handle();
+    return websocketpp::lib::error_code();
+}
+
+void WebInterface::on_socket_init(WebInterface::connection_hdl hdl, websocketpp::lib::asio::ip::tcp::socket& socket)
+{
+    //called for each accepted connection, http requests included
+    scoped_lock lock(parametersMutex);
+    socketFds[hdl] = (int)socket.native_handle();
+}
+
+
+void WebInterface::on_http(WebInterface::connection_hdl hdl) {
+    // Upgrade our connection handle to a full connection_ptr
+    server::connection_ptr con = m_endpoint.get_con_from_hdl(hdl);
+
+    std::string resource = con->get_uri()->get_resource();
+
+    m_endpoint.get_alog().write(websocketpp::log::alevel::app,
+                                "http request: "+resource);
+    httpRequests++;
+
+    if(!metricsPath.empty() && resource == metricsPath)
+    {
+        con->append_header("Content-Type", "text/plain; version=0.0.4");
+        con->append_header("Cache-Control", "no-store");
+        con->set_body(getMetricsText());
+        con->set_status(websocketpp::http::status_code::ok);
+        return;
+    }
+
+    std::shared_ptr<const Asset> asset = m_assets.find(resource);
+    if (!asset) {
+        // 404 error
+        std::stringstream ss;
+
+        ss << "<!doctype html><html><head>"
            << "<title>Error 404 (Resource not found)</title><body>"
            << "<h1>Error 404</h1>"
-           << "<p>The requested URL " << filename << " was not found on this server.</p>"
+           << "<p>The requested URL " << resource << " was not found on this server.</p>"
            << "</body></head></html>";
 
         con->set_body(ss.str());
@@ -337,23 +2251,117 @@ void WebInterface::on_http(WebInterface::connection_hdl hdl) {
         return;
     }
 
-    file.seekg(0, std::ios::end);
-    response.reserve(file.tellg());
-    file.seekg(0, std::ios::beg);
+    //the browser revalidates its copy at each load, and gets a 304 without body if it is still up to date
+    con->append_header("ETag", asset->etag);
+    con->append_header("Cache-Control", "no-cache");
+    if(!asset->lastModified.empty())
+    {
+        con->append_header("Last-Modified", asset->lastModified);
+    }
+
+    const std::string& ifNoneMatch = con->get_request_header("If-None-Match");
+    if((!ifNoneMatch.empty() && ifNoneMatch.find(asset->etag) != std::string::npos) ||
+            (ifNoneMatch.empty() && !asset->lastModified.empty() && con->get_request_header("If-Modified-Since") == asset->lastModified))
+    {
+        con->set_status(websocketpp::http::status_code::not_modified);
+        return;
+    }
 
-    response.assign((std::istreambuf_iterator<char>(file)),
-                    std::istreambuf_iterator<char>());
+    con->append_header("Content-Type", asset->contentType);
+    con->append_header("Vary", "Accept-Encoding");
 
-    con->set_body(response);
+    const std::string& acceptEncoding = con->get_request_header("Accept-Encoding");
+    if(!asset->gzipBody.empty() && acceptEncoding.find("gzip") != std::string::npos)
+    {
+        con->append_header("Content-Encoding", "gzip");
+        con->set_body(asset->gzipBody);
+    }
+    else if(!asset->deflateBody.empty() && acceptEncoding.find("deflate") != std::string::npos)
+    {
+        con->append_header("Content-Encoding", "deflate");
+        con->set_body(asset->deflateBody);
+    }
+    else
+    {
+        con->set_body(asset->body);
+    }
     con->set_status(websocketpp::http::status_code::ok);
 }
 
 void WebInterface::on_open(WebInterface::connection_hdl hdl) {
-    m_connections.insert(hdl);
+    ConnectionData data;
+
+    server::connection_ptr con = m_endpoint.get_con_from_hdl(hdl);
+    data.acceptsPreparedFrames = !con->get_request_header("Sec-WebSocket-Version").empty();
+
+    //the shared compressed frames use a 15 bits window, they can't be sent if the client restricted the window of the server
+    const std::string& extensions = con->get_response_header("Sec-WebSocket-Extensions");
+    data.acceptsDeflate = data.acceptsPreparedFrames && extensions.find("permessage-deflate") != std::string::npos &&
+            (extensions.find("server_max_window_bits") == std::string::npos || extensions.find("server_max_window_bits=15") != std::string::npos);
+
+    const std::string& subprotocol = con->get_subprotocol();
+    data.binary = subprotocol == BinaryProtocol::subprotocol;
+    for(size_t i = 1; i<codecs.size(); i++)
+    {
+        if(subprotocol == codecs[i]->getSubprotocol())
+        {
+            data.codec = i;
+        }
+    }
+
+    data.connection = con;
+    data.id = ++connectionsOpened;
+    data.traffic = std::make_shared<TrafficCounters>();
+
+    scoped_lock lock(parametersMutex);
+    m_connections[hdl] = data;
+    if(data.binary)
+    {
+        binaryConnectionCount++;
+    }
+    if(data.codec != 0 && codecConnectionCounts[data.codec]++ == 0)
+    {
+        activeCodecs.fetch_or(1u << data.codec);
+    }
 }
 
 void WebInterface::on_close(WebInterface::connection_hdl hdl) {
-    m_connections.erase(hdl);
+    scoped_lock lock(parametersMutex);
+    auto con = m_connections.find(hdl);
+    if(con != m_connections.end())
+    {
+        if(con->second.binary)
+        {
+            binaryConnectionCount--;
+        }
+        size_t codec = con->second.codec;
+        if(codec != 0 && --codecConnectionCounts[codec] == 0)
+        {
+            activeCodecs.fetch_and(~(1u << codec));
+        }
+        m_connections.erase(con);
+        connectionsClosed++;
+    }
+}
+
+bool WebInterface::on_validate(WebInterface::connection_hdl hdl) {
+    server::connection_ptr con = m_endpoint.get_con_from_hdl(hdl);
+
+    //the first subprotocol requested by the client that the server supports is selected
+    for(const std::string& protocol: con->get_requested_subprotocols())
+    {
+        bool supported = protocol == BinaryProtocol::subprotocol;
+        for(size_t i = 1; i<codecs.size() && !supported; i++)
+        {
+            supported = protocol == codecs[i]->getSubprotocol();
+        }
+        if(supported)
+        {
+            con->select_subprotocol(protocol);
+            break;
+        }
+    }
+    return true;
 }
 
 
@@ -35,29 +35,83 @@
 #pragma once
 
 #include <InstantInterface/InterfaceManager.h>
+#include <InstantInterface/CommandQueue.h>
+#include <InstantInterface/AssetCache.h>
+#include <InstantInterface/BinaryProtocol.h>
+#include <InstantInterface/WireCodec.h>
+#include <InstantInterface/Metrics.h>
 
 #include <websocketpp/server.hpp>
 #include <websocketpp/config/asio_no_tls.hpp>
-
+#include <websocketpp/extensions/permessage_deflate/enabled.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <set>
 #include <string>
+#include <vector>
 
 
 namespace InstantInterface
 {
 
+/**
+ * @brief configuration of the server, with the permessage-deflate extension negotiated with the clients that offer it
+ */
+struct WebInterfaceServerConfig : public websocketpp::config::asio
+{
+    typedef WebInterfaceServerConfig type;
+    typedef websocketpp::config::asio base;
+
+    struct permessage_deflate_config
+    {
+        typedef base::request_type request_type;
+    };
+    typedef websocketpp::extensions::permessage_deflate::enabled<permessage_deflate_config> permessage_deflate_type;
+};
+
 /**
  * @brief The WebInterface class implement the InterfaceManager to the case of web interface. It makes the interface available on a web page on the local network.
+ * The clients opening the websocket with the subprotocol BinaryProtocol::subprotocol receive the values in binary frames instead of json
+ * (see BinaryProtocol.h), and can send binary update and action messages. Any client can still send json messages.
+ * The clients requesting the subprotocol of a WireCodec (MessagePack and CBOR per default, see addWireCodec()) exchange all
+ * their messages in the encoding of the codec.
  */
 class WebInterface: public InterfaceManager {
 public:
 
 
     typedef websocketpp::connection_hdl connection_hdl;
-    typedef websocketpp::server<websocketpp::config::asio> server;
+    typedef WebInterfaceServerConfig server_config;
+    typedef websocketpp::server<server_config> server;
+    typedef server::message_ptr message_ptr;
+
+    /**
+     * @brief message framed once and shared by all the connections, in its plain and its compressed (permessage-deflate) versions
+     */
+    struct SharedFrame
+    {
+        message_ptr plain;
+        // nullptr if the message is too small to be compressed
+        message_ptr deflated;
+        // the message encoded by each wire codec in use when the frame was built (indexed by codec, nullptr for the other codecs)
+        std::vector<std::shared_ptr<const SharedFrame> > encoded;
+    };
+    typedef std::shared_ptr<const SharedFrame> frame_ptr;
     typedef std::lock_guard<std::mutex> scoped_lock;
 
-    WebInterface(bool withThread = false);
+    /**
+     * @brief constructor
+     * @param withThread runs the server in its own thread
+     * @param commandQueueCapacity in threaded mode, maximum number of received commands waiting for executeCommands(). The commands received when the queue is full are dropped.
+     */
+    WebInterface(bool withThread = false, size_t commandQueueCapacity = 1024);
+
+    ~WebInterface();
 
     /**
      * @brief closes all connections to clients and disconnects the server.
@@ -67,7 +121,8 @@ public:
     /**
      * @brief starts server on the specified port \p port that will delivers the content found at the path \p docroot
      * @param port server port
-     * @param docroot path to the content to be delivered. If docroot == "#" then the path will be looked for in a file named pathToWebInterface.txt
+     * @param docroot path to the content to be delivered. If docroot == "#" then the web interface compiled into the library is delivered
+     * (CMake option INSTANTINTERFACE_EMBED_WEBAPP), or if there is none, the path will be looked for in a file named pathToWebInterface.txt
      */
     void init(uint16_t port, std::string docroot = "#");
 
@@ -77,17 +132,122 @@ public:
      */
     bool poll();
 
+    /**
+     * @brief runs at most \p maxHandlers ready handlers of the server, for at most \p maxDuration (alternative to poll(),
+     * when withThreaded=false). A handler already started is not interrupted, so \p maxDuration can be exceeded by one handler.
+     * Meant for the programs that run their own event loop with time constraints (see getFileDescriptors() and getPollTimeout()).
+     * @param maxHandlers maximum number of handlers run, 0 for no limit
+     * @param maxDuration maximum time spent in the function, 0 for no limit
+     * @return the number of handlers run
+     */
+    size_t poll(size_t maxHandlers, std::chrono::microseconds maxDuration);
+
+    /**
+     * @brief returns the sockets of the server (the listening socket and the sockets of the clients) when withThreaded=false,
+     * so that a program running its own event loop (poll, epoll, select...) can call poll() when one of them is readable.
+     * The sockets change as the clients connect and disconnect, the list has to be read again after each call to poll().
+     * @return the file descriptors, empty on the systems where the sockets are not file descriptors
+     */
+    std::vector<int> getFileDescriptors();
+
+    /**
+     * @brief returns the time after which poll() has to be called even if none of the sockets of getFileDescriptors() is readable:
+     * 0 if handlers are still waiting after a poll() that ran out of budget, otherwise the time until the next broadcast,
+     * limited to \p maxTimeout for the internal timers of the server and the sockets waiting to be writable
+     * @param maxTimeout
+     * @return the timeout to give to the event loop
+     */
+    std::chrono::milliseconds getPollTimeout(std::chrono::milliseconds maxTimeout = std::chrono::milliseconds(100));
+
     /**
      * @brief runs the server. The server is started in a thread if \p withThread has been set to \p true in the constructor.
      * Otherwise, calling run() is blocking.
      */
     void run();
 
+    /**
+     * @brief sets the number of threads running the server in threaded mode (1 per default). Must be called before run().
+     * The messages of a connection are still handled in order, but different connections can be served in parallel.
+     * @param count number of threads
+     */
+    void setThreadCount(unsigned int count);
+
+    /**
+     * @brief the files of the web interface are loaded in memory by init(). With a non zero \p interval, the files that
+     * have changed on disk are reloaded when they are requested, at most once per \p interval (useful while developing the web interface).
+     * @param interval minimum time between two checks of the same file, 0 disables the reloading (default)
+     */
+    void setAssetRefreshInterval(std::chrono::milliseconds interval);
+
+    /**
+     * @brief enables or disables the compression of the messages sent to the clients that have negotiated permessage-deflate.
+     * Each message is compressed once and the compressed frame is shared by all the connections. Enabled per default. Can be called from any thread.
+     * @param enabled
+     * @param threshold minimum size in bytes of the messages that are compressed
+     */
+    void setCompression(bool enabled, size_t threshold = 1024);
+
+    /**
+     * @brief enables or disables the quantization on 16 bits of the float attributes with a min and a max in the binary value frames.
+     * The precision is then (max-min)/65535, which is enough for a slider. Disabled per default.
+     * @param enabled
+     */
+    void setBinaryQuantization(bool enabled);
+
+    /**
+     * @brief adds an encoding of the messages, selected by the clients requesting the subprotocol of \p codec.
+     * The json messages are encoded once per codec in use, and the encoded frames are shared by the clients of the codec.
+     * Must be called before init(). MessagePackCodec and CborCodec are added per default.
+     * @param codec
+     * @return false if the maximum number of codecs (31) has been reached
+     */
+    bool addWireCodec(std::shared_ptr<const WireCodec> codec);
+
     /**
      * @brief reads the messages received from the clients and execute the associated commands.
+     * In threaded mode, the update messages have already been parsed and resolved by the thread of the server
+     * (with the element handles published by updateStructureCache()), so only the new values are applied here.
      */
     void executeCommands();
 
+    /**
+     * @brief blocks until commands are waiting for executeCommands(), the server is stopped or \p timeout has elapsed.
+     * Unlike a sleep, an edit wakes the program up as soon as it has been received, and an idle program doesn't wake up.
+     * In threaded mode only, without thread it returns false immediately (the commands are executed by poll()).
+     * @return true if commands are waiting
+     */
+    bool waitForCommands(std::chrono::milliseconds timeout);
+
+    /**
+     * @brief returns a file descriptor which becomes readable when commands are waiting for executeCommands(), for integrating
+     * the interface in an event loop (poll, epoll, select...). executeCommands() resets it. The descriptor is owned by the WebInterface.
+     * @return an eventfd on Linux, -1 on the other systems or if it couldn't be created
+     */
+    int getCommandFd();
+
+    /**
+     * @brief returns the number of received commands waiting for executeCommands()
+     */
+    size_t getCommandQueueDepth() const;
+
+    /**
+     * @brief returns the number of received commands that have been dropped because the command queue was full
+     */
+    uint64_t getCommandOverflowCount() const;
+
+    /**
+     * @brief enables or disables the coalescing of the received updates (threaded mode only). When enabled, executeCommands()
+     * applies only the last of the pending values of each attribute, so that a slider drag sets the attribute once per call
+     * instead of once per message. The actions and the other commands are all executed, in the order of reception.
+     * @param enabled (disabled per default)
+     */
+    void setUpdateCoalescing(bool enabled);
+
+    /**
+     * @brief returns the number of received values skipped by the coalescing of the updates
+     */
+    uint64_t getCoalescedUpdateCount() const;
+
     /**
      * @brief updates the cache of the structure of the interface. Required only in threaded mode.
      */
@@ -108,6 +268,151 @@ public:
      */
     void forceRefreshStructureAll();
 
+    /**
+     * @brief enables or disables the delta mode of forceRefreshAll(). In delta mode, only the values of the attributes that have changed
+     * since the previous refresh are sent to the clients. A delta made only of the values set by a client is not sent back to this client.
+     * In both modes, the update messages carrying a sequence number ("seq") are acknowledged to their client by an "ack" message
+     * after the broadcast of the values, so that the client can ignore the echoes of its edits older than its current state.
+     * @param enabled true for enabling the delta mode (disabled per default)
+     * @param fullRefreshPeriod number of refreshes after which all the values are sent anyway. 0 means never.
+     */
+    void setDeltaRefresh(bool enabled, unsigned int fullRefreshPeriod = 100);
+
+    /**
+     * @brief starts broadcasting the values to the connected clients at a fixed rate from the thread of the server,
+     * so that the program doesn't have to call forceRefreshAll() anymore. The changes made between two broadcasts are coalesced.
+     * The structure is broadcast at the next tick after updateStructureCache() has been called.
+     * In threaded mode, the program still has to call updateParameterCache() (and updateStructureCache() when the structure changes)
+     * to publish the new values, but it doesn't pay for the network anymore.
+     * @param valuesRate broadcast frequency in Hz, 0 stops the broadcasts
+     */
+    void setBroadcastRate(float valuesRate);
+
+    /**
+     * @brief sets the backpressure of the broadcasts. While more than \p sendBufferLimit bytes are waiting to be written to a client,
+     * the broadcasts are not queued for it anymore: the connection only remembers that its structure or its values are out of date,
+     * and receives the current ones at the first broadcast after it has caught up (the latest values win).
+     * The replies to the requests of the client ("send_interface", "update"...) are always sent.
+     * @param sendBufferLimit in bytes, 0 disables the backpressure (256 KiB per default)
+     * @param maxLag a client staying over the limit for longer than \p maxLag is disconnected, 0 means never (default)
+     */
+    void setBackpressure(size_t sendBufferLimit, std::chrono::milliseconds maxLag = std::chrono::milliseconds(0));
+
+    /**
+     * @brief returns the number of broadcasts that haven't been sent to a client because it was too slow (see setBackpressure())
+     */
+    uint64_t getDeferredBroadcastCount();
+
+    /**
+     * @brief sets the number of value deltas kept for the clients resuming after a reconnection. In delta mode, the update messages
+     * carry the state version of their values, and a reconnecting client sends "resume <session> <version> <hash>" with the
+     * session of the server, the last version it has received and the hash of its structure. It then only receives the deltas
+     * broadcast since that version, or the whole structure and values if they are not kept anymore.
+     * @param count number of broadcast deltas kept (128 per default), 0 disables the resume
+     */
+    void setResumeCapacity(size_t count);
+
+    /**
+     * @brief cumulated duration and number of runs of a task
+     */
+    struct TaskDurations
+    {
+        uint64_t count;
+        double seconds;
+    };
+
+    /**
+     * @brief snapshot of the telemetry of the server
+     */
+    struct Metrics
+    {
+        /**
+         * @brief traffic of an open connection
+         */
+        struct Connection
+        {
+            // number given to the connection when it was opened
+            uint64_t id;
+            std::string subprotocol;
+            uint64_t messagesReceived;
+            uint64_t bytesReceived;
+            uint64_t messagesSent;
+            uint64_t bytesSent;
+            // bytes waiting to be written to the socket
+            size_t bufferedBytes;
+        };
+
+        // websocket traffic of all the connections, including the closed ones. The sizes are the ones of the payloads.
+        uint64_t messagesReceived;
+        uint64_t bytesReceived;
+        uint64_t messagesSent;
+        uint64_t bytesSent;
+        uint64_t httpRequests;
+
+        uint64_t connectionsOpened;
+        uint64_t connectionsClosed;
+        std::vector<Connection> connections;
+
+        // commands received and not executed yet, and commands dropped because the queue was full
+        size_t commandQueueDepth;
+        size_t commandQueueCapacity;
+        uint64_t droppedCommands;
+
+        TaskDurations executeCommands;
+        TaskDurations updateParameterCache;
+        TaskDurations updateStructureCache;
+        // broadcasts which have sent at least one message
+        TaskDurations broadcast;
+        uint64_t deferredBroadcasts;
+    };
+
+    /**
+     * @brief returns the telemetry of the server. Can be called from any thread.
+     */
+    Metrics getMetrics();
+
+    /**
+     * @brief returns the telemetry of the server in the Prometheus text format, as served by the http route set by setMetricsPath()
+     */
+    std::string getMetricsText();
+
+    /**
+     * @brief sets the http route serving getMetricsText() ("/metrics" per default). Must be called before init().
+     * @param path resource path, empty for not serving the metrics
+     */
+    void setMetricsPath(const std::string& path);
+
+    /**
+     * @brief stages of the path of a command received from a client
+     */
+    enum LatencyStage
+    {
+        // from the reception of the message to the queueing of the command (parsing and resolution)
+        LATENCY_PARSE,
+        // time spent in the command queue, waiting for executeCommands() and then for the commands before it in the same call
+        LATENCY_QUEUE,
+        // execution of the command (AttributeT::set() or executeSingleCommand())
+        LATENCY_APPLY,
+        // from the reception of the message to the end of the execution
+        LATENCY_TOTAL,
+        // from the timestamp given by the client ("t" in ms since the epoch) to the end of the execution.
+        // Only meaningful if the clocks of the client and the server are synchronized.
+        LATENCY_CLIENT,
+        LATENCY_STAGE_COUNT
+    };
+
+    /**
+     * @brief returns the latencies of the executed commands at the \p stage, which can be queried or dumped from any thread
+     */
+    const LatencyHistogram& getLatencyHistogram(LatencyStage stage) const;
+
+    /**
+     * @brief writes the latencies of all the stages, one stage per line
+     */
+    void dumpLatencies(std::ostream& stream) const;
+
+    void resetLatencies();
+
 protected:
 
     /**
@@ -121,7 +426,33 @@ private:
 
     void on_message(websocketpp::connection_hdl hdl, server::message_ptr msg);
 
-    void send_interface(websocketpp::connection_hdl hdl );
+    /**
+     * @brief selects the binary subprotocol if the client requests it
+     */
+    bool on_validate(connection_hdl hdl);
+
+    /**
+     * @brief handles a text command ("send_interface", "update", "subscribe <path>", "accept_patches"...) or a json message
+     */
+    void on_text(connection_hdl hdl, const std::string& content);
+
+    /**
+     * @brief handles a message decoded by the wire codec of the connection
+     */
+    void on_decoded(connection_hdl hdl, const Json::Value& message);
+
+    /**
+     * @brief sends the structure of the interface followed by the values. If \p knownHash is the hash of the current structure,
+     * the client already has it and an "unchanged" message is sent instead of the structure.
+     */
+    void send_interface(websocketpp::connection_hdl hdl, const std::string& knownHash = "");
+
+    /**
+     * @brief sends the deltas broadcast after the state \p version to a reconnecting client, or falls back to send_interface()
+     * if the deltas are not kept anymore, if the server has been restarted (\p session) or if the structure has changed.
+     * A client with subscriptions receives the current values of its groups instead of the deltas.
+     */
+    void resume(connection_hdl hdl, const std::string& session, uint64_t version, const std::string& knownHash);
 
     void on_http(connection_hdl hdl);
 
@@ -131,33 +462,542 @@ private:
 
     void send_values_update(websocketpp::connection_hdl hdl);
 
+    /**
+     * @brief adds (\p enable = true) or removes the group \p groupPath (and its subgroups) from the subscriptions of the client.
+     * A client without subscription receives the values of all the groups.
+     */
+    void subscribe(connection_hdl hdl, const std::string& groupPath, bool enable);
+
+    /**
+     * @brief builds a websocket frame containing \p payload. The frame is ready to be written as it is to the socket,
+     * so that the same frame can be shared by all the connections without being copied or reframed.
+     * The payloads larger than the compression threshold are also deflated once for the connections using permessage-deflate.
+     */
+    frame_ptr makeFrame(const std::string& payload, websocketpp::frame::opcode::value op = websocketpp::frame::opcode::text);
 
-    typedef std::set<connection_hdl,std::owner_less<connection_hdl>> con_list;
+    message_ptr makePreparedMessage(const std::string& payload, websocketpp::frame::opcode::value op, bool compressed);
+
+    /**
+     * @brief fills the plain and the compressed messages of \p frame
+     */
+    void prepareFrame(SharedFrame& frame, const std::string& payload, websocketpp::frame::opcode::value op);
+
+    /**
+     * @brief builds the frame of the json message \p json encoded by the codec \p codec
+     * @return nullptr if the message can't be encoded
+     */
+    frame_ptr makeEncodedFrame(const std::string& json, size_t codec);
+
+    /**
+     * @brief frame to send to a connection, collected under parametersMutex and sent after releasing it
+     */
+    struct PendingSend
+    {
+        connection_hdl hdl;
+        frame_ptr frame;
+        bool acceptsPreparedFrames;
+        bool acceptsDeflate;
+        // wire codec of the connection, 0 for json
+        size_t codec;
+        // counters of the connection, nullptr if it is not open anymore
+        std::shared_ptr<TrafficCounters> traffic;
+        // 1 + index of the SubscriptionUpdate whose frame is assembled after releasing parametersMutex, 0 if the frame is set
+        size_t subscription;
+    };
+    typedef std::vector<PendingSend> SendList;
+
+    /**
+     * @brief structure of the interface published by updateStructureCache(). A snapshot is never modified once published,
+     * so that the threads of the server can send its frames without holding any lock.
+     */
+    struct StructureSnapshot
+    {
+        StructureSnapshot() : revision(0), generation(0), handleGeneration(0) {}
+
+        frame_ptr structure;
+        // reply to the clients that already have this structure
+        frame_ptr unchanged;
+        // edits since the structure identified by patchBaseHash (nullptr if a patch can't be built)
+        frame_ptr patch;
+        std::string patchBaseHash;
+        // hash of the structure, sent in the structure message
+        std::string hash;
+        // revision of the structure (see InterfaceManager::getStructureRevision())
+        uint64_t revision;
+
+        // paths of the groups, in the order of the value fragments, and number identifying them for the group masks
+        std::vector<std::string> groupPaths;
+        unsigned int generation;
+
+        // handles of the elements of the interface used to resolve the received updates, and type of the element of each handle
+        std::shared_ptr<const ElementHandleMap> elementHandles;
+        std::shared_ptr<const std::vector<TypeValue> > handleTypes;
+        uint64_t handleGeneration;
+    };
+    typedef std::shared_ptr<const StructureSnapshot> structure_snapshot_ptr;
+
+    /**
+     * @brief values published by updateParameterCache(), never modified once published
+     */
+    struct ValuesSnapshot
+    {
+        ValuesSnapshot() : version(0), since(0), echoOnly(false) {}
+
+        frame_ptr values;
+        // values changed since the state version \p since, nullptr if none or out of delta mode
+        frame_ptr delta;
+        // binary frames, only built while binary clients are connected (nullptr otherwise)
+        frame_ptr binaryValues;
+        frame_ptr binaryDelta;
+
+        // values serialized group by group, for the clients with subscriptions
+        std::vector<std::string> valueFragments;
+        std::vector<std::string> deltaFragments;
+        std::vector<std::string> binaryValueFragments;
+        std::vector<std::string> binaryDeltaFragments;
+
+        // state version of the values (0 out of delta mode)
+        uint64_t version;
+        uint64_t since;
+
+        // client whose values are the only ones in the delta (if echoOnly), which is not sent to it
+        connection_hdl echoOrigin;
+        bool echoOnly;
+    };
+    typedef std::shared_ptr<const ValuesSnapshot> values_snapshot_ptr;
+
+    /**
+     * @brief update message of the groups selected by \p mask, assembled from the fragments of a snapshot
+     */
+    struct SubscriptionUpdate
+    {
+        bool binary;
+        bool delta;
+        std::vector<bool> mask;
+    };
+    typedef std::vector<SubscriptionUpdate> SubscriptionList;
+
+    /**
+     * @brief returns the PendingSend of \p frame for the connection \p hdl. Requires parametersMutex.
+     */
+    PendingSend makeSend(connection_hdl hdl, frame_ptr frame);
+
+    void sendFrame(const PendingSend& send);
+
+    /**
+     * @brief adds \p frame for all the connections to \p sends. Requires parametersMutex.
+     */
+    void collectFrame(frame_ptr frame, SendList& sends);
+
+    /**
+     * @brief broadcasts the values cache (or the delta cache in delta mode) if it has been updated since the last broadcast
+     */
+    void broadcastValues();
+
+    /**
+     * @brief broadcasts the structure cache followed by the values cache if the structure has been updated since the last broadcast
+     * @return true if the structure has been broadcast
+     */
+    bool broadcastStructure();
+
+    void scheduleBroadcast();
+
+    void on_broadcast_timer(unsigned int generation, const websocketpp::lib::error_code& ec);
+
+    websocketpp::lib::error_code on_tcp_pre_bind(websocketpp::transport::asio::acceptor_ptr acceptor);
+
+    void on_socket_init(connection_hdl hdl, websocketpp::lib::asio::ip::tcp::socket& socket);
+
+    /**
+     * @brief data associated to each connection
+     */
+    struct ConnectionData
+    {
+        ConnectionData() : acceptsPreparedFrames(true), acceptsDeflate(false), acceptsPatches(false), binary(false), codec(0), pendingAck(0),
+            congested(false), structurePending(false), valuesPending(false), closing(false), id(0), maskGeneration(0) {}
+
+        // used to read the amount of data waiting to be written to the client
+        server::connection_ptr connection;
+
+        // false for the clients using the old hixie-76 protocol (hybi00), which uses another framing
+        bool acceptsPreparedFrames;
+        // true if permessage-deflate has been negotiated with parameters compatible with the shared compressed frames
+        bool acceptsDeflate;
+        // true if the client has announced that it applies the structure patches ("accept_patches"), the others receive
+        // the whole structure
+        bool acceptsPatches;
+        // true if the client has selected the binary subprotocol
+        bool binary;
+        // index of the wire codec selected by the client, 0 for json
+        size_t codec;
+        // sequence number of the last edit of the client applied since the last broadcast, 0 if none
+        uint64_t pendingAck;
+
+        // backpressure: true while the send buffer of the client is over the limit, since congestedSince
+        bool congested;
+        std::chrono::steady_clock::time_point congestedSince;
+        // the broadcasts skipped while congested, replaced by the current structure and values once the client has caught up
+        bool structurePending;
+        bool valuesPending;
+        // true once the connection has been closed for being too slow
+        bool closing;
+
+        // telemetry of the connection, shared with the pending sends
+        uint64_t id;
+        std::shared_ptr<TrafficCounters> traffic;
+
+        // hash of the structure the client has received
+        std::string structureHash;
+
+        // paths of the groups whose values are sent to the client (all the groups if empty)
+        std::set<std::string> subscriptions;
+        // groups of the current structure selected by the subscriptions, valid if maskGeneration == structureGeneration
+        std::vector<bool> groupMask;
+        unsigned int maskGeneration;
+    };
+
+    typedef std::map<connection_hdl,ConnectionData,std::owner_less<connection_hdl>> con_list;
+
+    static PendingSend makeSend(const con_list::value_type& connection, frame_ptr frame);
+
+    /**
+     * @brief returns the groups of the \p structure selected by the subscriptions of the connection \p data. Requires parametersMutex.
+     */
+    const std::vector<bool>& getGroupMask(ConnectionData& data, const StructureSnapshot& structure);
+
+    /**
+     * @brief writes into \p buffer the update message made of the \p fragments of the groups selected by \p mask,
+     * tagged with the state \p version if it isn't 0
+     * @return false if the message contains no value
+     */
+    static bool assembleUpdate(std::string& buffer, const std::vector<std::string>& fragments, const std::vector<bool>& mask, uint64_t version);
+
+    /**
+     * @brief same as assembleUpdate() for the binary fragments
+     */
+    static bool assembleBinaryUpdate(std::string& buffer, const std::vector<std::string>& fragments, const std::vector<bool>& mask);
+
+    /**
+     * @brief lists the frame to send to each connection: the (\p delta) frame of \p values (or its binary frame for the binary clients)
+     * for the clients without subscription. For the others, the message to assemble from the fragments is added to \p subscriptions.
+     * The binary clients receive the json frames when no binary frame has been built. Requires parametersMutex.
+     */
+    void collectUpdates(const ValuesSnapshot& values, const StructureSnapshot& structure, bool delta, SendList& sends,
+                        SubscriptionList& subscriptions);
+
+    /**
+     * @brief returns the PendingSend of all the values selected by the subscriptions of the \p connection. Requires parametersMutex.
+     */
+    PendingSend makeValuesSend(con_list::value_type& connection, const ValuesSnapshot& values, const StructureSnapshot& structure,
+                               SubscriptionList& subscriptions);
+
+    /**
+     * @brief adds the message of the groups selected by \p mask to \p subscriptions, unless it is already there
+     * @return the index of the message + 1, to be stored in PendingSend::subscription
+     */
+    static size_t addSubscription(SubscriptionList& subscriptions, bool binary, bool delta, const std::vector<bool>& mask);
+
+    /**
+     * @brief assembles the frames of the \p subscriptions from the fragments of \p values, and sets them in the \p sends which refer
+     * to them. Must be called without parametersMutex.
+     */
+    void assembleSubscriptions(const ValuesSnapshot& values, const SubscriptionList& subscriptions, SendList& sends);
+
+    /**
+     * @brief checks whether the send buffer of the \p connection is over the backpressure limit, and marks it to be closed
+     * when it has been for longer than the maximum lag. Requires parametersMutex.
+     * @return true if the broadcasts must not be sent to the connection
+     */
+    bool checkCongestion(con_list::value_type& connection);
+
+    /**
+     * @brief adds to \p sends the current structure and values of the connections which have skipped broadcasts
+     * and are not congested anymore. Requires parametersMutex.
+     */
+    void collectPendingBroadcasts(const ValuesSnapshot& values, const StructureSnapshot& structure, SendList& sends,
+                                  SubscriptionList& subscriptions);
+
+    /**
+     * @brief closes the connections marked by checkCongestion(). Must be called without parametersMutex.
+     */
+    void closeLaggingConnections();
+
+    /**
+     * @brief command received from a client, waiting for executeCommands()
+     */
+    struct ReceivedCommand
+    {
+        ReceivedCommand() : isElementUpdate(false), seq(0), clientTime(0) {}
+
+        // true if the command is an update already parsed and resolved, false if it is left to executeSingleCommand()
+        bool isElementUpdate;
+        ElementUpdate update;
+        std::string text;
+        // connection that sent the update, and sequence number of the edit given by the client (0 if none)
+        connection_hdl origin;
+        uint64_t seq;
+
+        // timestamps of the reception of the message, of the queueing and of the dequeueing of the command
+        std::chrono::steady_clock::time_point received;
+        std::chrono::steady_clock::time_point queued;
+        std::chrono::steady_clock::time_point dequeued;
+        // time given by the client in ms since the epoch, 0 if none
+        double clientTime;
+    };
+
+    /**
+     * @brief value of an element set by a client, which doesn't have to be sent back to it (program thread only)
+     */
+    struct EchoRecord
+    {
+        connection_hdl origin;
+        uint64_t handleGeneration;
+        // value sent by the client, serialized like the polled values
+        std::string valueJson;
+        // state version of the first pollStateChanges() after the edit, 0 before
+        uint64_t polledVersion;
+    };
+
+    /**
+     * @brief records the sequence number of \p command, to be acknowledged to its client with the next broadcast
+     */
+    void recordSequence(const ReceivedCommand& command);
+
+    static void writeValueJson(const ElementUpdate& update, std::string& buffer);
+
+    /**
+     * @brief checks whether all the values changed after the state version \p since have been set by the same client \p origin
+     * and are still the values it has sent, in which case the delta is not sent to it
+     */
+    bool findEchoOrigin(uint64_t since, connection_hdl& origin);
+
+    /**
+     * @brief returns a snapshot of the pool that no thread holds anymore, emptied, or a new one if they are all in use
+     */
+    std::shared_ptr<ValuesSnapshot> recycleValuesSnapshot();
+
+    /**
+     * @brief adds the acknowledgement of the last edit of each connection to \p sends. Must be called before adding the values,
+     * so that the clients don't ignore the values which override their edits. Requires parametersMutex.
+     */
+    void collectAcknowledgements(SendList& sends);
+
+    /**
+     * @brief adds the acknowledgement of the last edit of \p connection to \p sends, if there is one. Requires parametersMutex.
+     */
+    void collectAcknowledgement(con_list::value_type& connection, SendList& sends);
+
+    /**
+     * @brief delta broadcast to the clients, kept for the clients resuming after a reconnection
+     */
+    struct ResumeRecord
+    {
+        // state versions between which the values of the delta have changed
+        uint64_t since;
+        uint64_t version;
+        frame_ptr frame;
+        // nullptr if no binary frame has been built
+        frame_ptr binaryFrame;
+    };
+
+    /**
+     * @brief adds the delta of \p values, which is being broadcast, to the resume log. Requires parametersMutex.
+     */
+    void recordResumeDelta(const ValuesSnapshot& values);
+
+    /**
+     * @brief moves the sequence numbers published by updateParameterCache() to the connections. Must be called before loading
+     * the values snapshot, so that the values are at least as recent as the acknowledged edits. Requires parametersMutex.
+     */
+    void takeAcknowledgements();
 
     void addCommand(std::string const& command);
 
+    void pushCommand(const ReceivedCommand& command);
+
+    void executeCommand(const ReceivedCommand& command);
+
+    /**
+     * @brief parses an update message on the thread of the server and queues one typed update per value, so that
+     * executeCommands() has neither json parsing nor string lookup to do. The other messages are queued as text.
+     * Without thread, the commands are executed right away (see deliverCommand()).
+     */
+    void parseCommand(connection_hdl hdl, const std::string& content);
+
+    /**
+     * @brief same as parseCommand() for a message already decoded
+     * @param content the message as a json string if it is at hand, otherwise it is serialized from \p message when needed
+     */
+    void parseCommand(connection_hdl hdl, const Json::Value& message, const std::string& content);
+
+    /**
+     * @brief converts the json \p value to the \p type of the element into \p update
+     * @return false if \p value can't be converted to \p type
+     */
+    static bool convertValue(const Json::Value& value, TypeValue type, ElementUpdate& update);
+
+    /**
+     * @brief parses a message of the binary protocol on the thread of the server (threaded mode) and queues one typed update per record,
+     * or applies them directly in the thread of the program
+     */
+    void parseBinaryCommand(connection_hdl hdl, const std::string& payload);
+
+    /**
+     * @brief reads the value of a binary record with the tag \p tag and converts it to the \p type of the element into \p update
+     * @param valid set to false if the value can't be converted to \p type
+     * @return false if the payload is truncated or the tag is unknown, in which case the rest of the message can't be read
+     */
+    static bool readBinaryValue(BinaryReader& reader, uint8_t tag, TypeValue type, ElementUpdate& update, bool& valid);
+
+    /**
+     * @brief queues \p command in threaded mode, executes it otherwise
+     */
+    void deliverCommand(ReceivedCommand& command);
+
+    /**
+     * @brief wakes the program up if it is waiting for commands, in waitForCommands() or on the command file descriptor
+     */
+    void notifyCommands();
+
+    /**
+     * @brief writes to the command file descriptor unless it is already readable
+     */
+    void signalCommandFd(int fd);
+
+    /**
+     * @brief records the latencies of \p command, which has just been executed
+     */
+    void recordLatencies(const ReceivedCommand& command);
+
 
     server m_endpoint;
+    std::shared_ptr<server_config::con_msg_manager_type> m_msgManager;
     con_list m_connections;
     server::timer_ptr m_timer;
 
     std::string m_docroot;
+    AssetCache m_assets;
 
     // Telemetry data
-    uint64_t m_count;
-
-    std::queue<std::string> mainPrgMessages;
-    std::mutex mainPrgMessagesMutex;
-
+    TrafficCounters traffic;
+    std::atomic<uint64_t> httpRequests;
+    std::atomic<uint64_t> connectionsOpened;
+    std::atomic<uint64_t> connectionsClosed;
+    DurationCounter executeDurations;
+    DurationCounter parameterCacheDurations;
+    DurationCounter structureCacheDurations;
+    DurationCounter broadcastDurations;
+    LatencyHistogram latencies[LATENCY_STAGE_COUNT];
+    std::string metricsPath;
+
+    CommandQueue<ReceivedCommand> commandQueue;
+    // signal of the commands pushed while the program waits in waitForCommands()
+    std::mutex commandMutex;
+    std::condition_variable commandSignal;
+    std::atomic<bool> waitingForCommands;
+    // eventfd created by getCommandFd() (-1 before), and whether it is readable
+    std::atomic<int> commandFd;
+    std::atomic<bool> commandFdSignaled;
+    // reusable command of the consumer (program thread)
+    ReceivedCommand commandBuffer;
+
+    // coalescing of the updates, only accessed from the program thread
+    bool coalesceUpdates;
+    uint64_t coalescedCount;
+    std::vector<ReceivedCommand> pendingCommands;
+    // index in pendingCommands of the last update of each element handle
+    std::unordered_map<size_t, size_t> lastUpdates;
+
+    // echo suppression, only accessed from the program thread: values set by the clients indexed by element handle,
+    // and sequence number of the last edit of each client
+    std::unordered_map<size_t, EchoRecord> echoes;
+    std::map<connection_hdl, uint64_t, std::owner_less<connection_hdl> > receivedSequences;
+    std::vector<size_t> changedElements;
+
+    // protects m_connections and the state of the broadcasts, shared by the threads of the server (the program thread only takes it
+    // in the calls it makes to the server, never for publishing the caches)
     std::mutex parametersMutex;
     bool m_stopped;
 
-    std::thread thread;
+    std::vector<std::thread> threads;
+    unsigned int threadCount;
     bool threaded;
 
 
-    std::string structureCache;
-    std::string valuesCache;
+    // snapshots published by updateStructureCache() and updateParameterCache() (std::atomic_store), read without lock
+    structure_snapshot_ptr structureSnapshot;
+    values_snapshot_ptr valuesSnapshot;
+    // snapshots last broadcast, protected by parametersMutex. The structure is also read by updateStructureCache() (std::atomic_load)
+    // as the base of the next patch.
+    structure_snapshot_ptr broadcastStructureSnapshot;
+    values_snapshot_ptr broadcastValuesSnapshot;
+
+    // binary value frames, only built while binary clients are connected
+    std::atomic<unsigned int> binaryConnectionCount;
+    bool binaryQuantization;
+
+    // wire codecs, the index 0 standing for json (nullptr)
+    std::vector<std::shared_ptr<const WireCodec> > codecs;
+    // number of connections of each codec, and bit mask of the codecs with at least one connection
+    std::vector<unsigned int> codecConnectionCounts;
+    std::atomic<unsigned int> activeCodecs;
+
+    // set from any thread while the frames are prepared on the others
+    std::atomic<bool> compressionEnabled;
+    std::atomic<size_t> compressionThreshold;
+
+    // backpressure of the broadcasts (see setBackpressure()), protected by parametersMutex
+    size_t sendBufferLimit;
+    std::chrono::milliseconds maxLag;
+    uint64_t deferredBroadcastCount;
+    std::vector<connection_hdl> laggingConnections;
+
+    // incremented by each structure snapshot, program thread only
+    unsigned int structureGeneration;
+
+    // buffers in which the caches are serialized before being framed (program thread only)
+    std::string structureBuffer;
+    std::string valuesBuffer;
+    std::string deltaBuffer;
+    std::string binaryValuesBuffer;
+    std::string binaryDeltaBuffer;
+    std::string patchBuffer;
+    // snapshots of the values published recently, reused once released so that their fragments keep their memory, and mask
+    // selecting all the groups (program thread only)
+    std::vector<std::shared_ptr<ValuesSnapshot> > valuesSnapshotPool;
+    std::vector<bool> allGroups;
+
+    // sequence numbers of the edits published with the values, waiting for the next broadcast
+    std::mutex acknowledgementsMutex;
+    std::map<connection_hdl, uint64_t, std::owner_less<connection_hdl> > publishedSequences;
+
+    // identifies this run of the server, so that the clients don't resume from the versions of a previous run
+    std::string sessionId;
+    // deltas broadcast recently, protected by parametersMutex. The clients which have the state resumeBaseVersion or a later one
+    // can catch up from the log.
+    std::deque<ResumeRecord> resumeLog;
+    size_t resumeCapacity;
+    uint64_t resumeBaseVersion;
+
+    // read without lock by the program thread, the period and the count are protected by parametersMutex
+    std::atomic<bool> deltaRefresh;
+    unsigned int fullRefreshPeriod;
+    unsigned int refreshCount;
+    // version of the last values broadcast, from which the program thread computes the next delta
+    std::atomic<uint64_t> lastRefreshVersion;
+
+    // serializes the handlers of the broadcast timer when the server runs on several threads
+    std::unique_ptr<websocketpp::lib::asio::io_service::strand> broadcastStrand;
+    // period of the broadcast timer in ms (0 when disabled), only accessed through broadcastStrand
+    long broadcastPeriod;
+    unsigned int broadcastGeneration;
+    std::chrono::steady_clock::time_point nextBroadcast;
+
+    // sockets of the server for the external event loops, protected by parametersMutex
+    int listenFd;
+    std::map<connection_hdl, int, std::owner_less<connection_hdl>> socketFds;
+    // true if the last poll() ran out of budget before the ready handlers
+    bool handlersPending;
 };
 
 }
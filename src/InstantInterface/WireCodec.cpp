@@ -0,0 +1,721 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+#include "WireCodec.h"
+#include <json/json.h>
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+namespace InstantInterface {
+
+namespace
+{
+
+// maximum nesting of the decoded messages, which are much flatter
+const int maxDepth = 64;
+
+void appendBigEndian(std::string& out, uint64_t v, int bytes)
+{
+    for(int i = bytes-1; i>=0; i--)
+    {
+        out.push_back((char)((v >> (8*i)) & 0xff));
+    }
+}
+
+uint64_t doubleBits(double v)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &v, sizeof(bits));
+    return bits;
+}
+
+/**
+ * @brief reads big endian numbers from a received payload, without reading past its end
+ */
+class PayloadReader
+{
+public:
+    PayloadReader(const std::string& payload) : in(payload), position(0) {}
+
+    bool byte(uint8_t& v)
+    {
+        if(position >= in.size())
+        {
+            return false;
+        }
+        v = (uint8_t)in[position++];
+        return true;
+    }
+
+    bool bigEndian(uint64_t& v, int bytes)
+    {
+        if(in.size() - position < (size_t)bytes)
+        {
+            return false;
+        }
+        v = 0;
+        for(int i = 0; i<bytes; i++)
+        {
+            v = (v << 8) | (uint8_t)in[position++];
+        }
+        return true;
+    }
+
+    bool string(uint64_t length, Json::Value& value)
+    {
+        if(in.size() - position < length)
+        {
+            return false;
+        }
+        value = Json::Value(in.data()+position, in.data()+position+length);
+        position += length;
+        return true;
+    }
+
+    /**
+     * @brief returns false if \p count items can't fit in the rest of the payload (each item takes at least one byte)
+     */
+    bool canHold(uint64_t count) const
+    {
+        return count <= in.size() - position;
+    }
+
+    bool atEnd() const
+    {
+        return position == in.size();
+    }
+
+private:
+    const std::string& in;
+    size_t position;
+};
+
+Json::Value makeInteger(int64_t v)
+{
+    return Json::Value((Json::Int64)v);
+}
+
+Json::Value makeUnsigned(uint64_t v)
+{
+    if(v <= (uint64_t)INT64_MAX)
+    {
+        return Json::Value((Json::Int64)v);
+    }
+    return Json::Value((Json::UInt64)v);
+}
+
+bool parseJson(const std::string& json, Json::Value& value)
+{
+    Json::Reader reader;
+    return reader.parse(json, value, false);
+}
+
+/***
+ *  MessagePack
+ */
+
+void msgpackUnsigned(std::string& out, uint64_t v)
+{
+    if(v < 128)
+    {
+        out.push_back((char)v);
+    }
+    else if(v <= UINT8_MAX)
+    {
+        out.push_back((char)0xcc);
+        appendBigEndian(out, v, 1);
+    }
+    else if(v <= UINT16_MAX)
+    {
+        out.push_back((char)0xcd);
+        appendBigEndian(out, v, 2);
+    }
+    else if(v <= UINT32_MAX)
+    {
+        out.push_back((char)0xce);
+        appendBigEndian(out, v, 4);
+    }
+    else
+    {
+        out.push_back((char)0xcf);
+        appendBigEndian(out, v, 8);
+    }
+}
+
+void msgpackSigned(std::string& out, int64_t v)
+{
+    if(v >= 0)
+    {
+        msgpackUnsigned(out, v);
+    }
+    else if(v >= -32)
+    {
+        out.push_back((char)v);
+    }
+    else if(v >= INT8_MIN)
+    {
+        out.push_back((char)0xd0);
+        appendBigEndian(out, (uint64_t)v, 1);
+    }
+    else if(v >= INT16_MIN)
+    {
+        out.push_back((char)0xd1);
+        appendBigEndian(out, (uint64_t)v, 2);
+    }
+    else if(v >= INT32_MIN)
+    {
+        out.push_back((char)0xd2);
+        appendBigEndian(out, (uint64_t)v, 4);
+    }
+    else
+    {
+        out.push_back((char)0xd3);
+        appendBigEndian(out, (uint64_t)v, 8);
+    }
+}
+
+/**
+ * @brief writes the header of a string, an array or a map: fix format if \p size < \p fixLimit, otherwise the 8 (strings only), 16 or 32 bits format
+ */
+void msgpackHeader(std::string& out, uint64_t size, uint8_t fixFormat, uint64_t fixLimit, uint8_t format8, uint8_t format16)
+{
+    if(size < fixLimit)
+    {
+        out.push_back((char)(fixFormat | size));
+    }
+    else if(format8 != 0 && size <= UINT8_MAX)
+    {
+        out.push_back((char)format8);
+        appendBigEndian(out, size, 1);
+    }
+    else if(size <= UINT16_MAX)
+    {
+        out.push_back((char)format16);
+        appendBigEndian(out, size, 2);
+    }
+    else
+    {
+        out.push_back((char)(format16+1));
+        appendBigEndian(out, size, 4);
+    }
+}
+
+bool msgpackDecode(PayloadReader& reader, Json::Value& value, int depth);
+
+bool msgpackDecodeArray(PayloadReader& reader, uint64_t count, Json::Value& value, int depth)
+{
+    if(!reader.canHold(count))
+    {
+        return false;
+    }
+    value = Json::Value(Json::arrayValue);
+    for(uint64_t i = 0; i<count; i++)
+    {
+        if(!msgpackDecode(reader, value[(Json::ArrayIndex)i], depth+1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool msgpackDecodeMap(PayloadReader& reader, uint64_t count, Json::Value& value, int depth)
+{
+    if(!reader.canHold(count))
+    {
+        return false;
+    }
+    value = Json::Value(Json::objectValue);
+    Json::Value key;
+    for(uint64_t i = 0; i<count; i++)
+    {
+        if(!msgpackDecode(reader, key, depth+1) || !key.isString() || !msgpackDecode(reader, value[key.asString()], depth+1))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool msgpackDecode(PayloadReader& reader, Json::Value& value, int depth)
+{
+    uint8_t b;
+    uint64_t v;
+    if(depth > maxDepth || !reader.byte(b))
+    {
+        return false;
+    }
+
+    if(b <= 0x7f)
+    {
+        value = makeInteger(b);
+        return true;
+    }
+    if(b >= 0xe0)
+    {
+        value = makeInteger((int8_t)b);
+        return true;
+    }
+    if((b & 0xf0) == 0x80)
+    {
+        return msgpackDecodeMap(reader, b & 0x0f, value, depth);
+    }
+    if((b & 0xf0) == 0x90)
+    {
+        return msgpackDecodeArray(reader, b & 0x0f, value, depth);
+    }
+    if((b & 0xe0) == 0xa0)
+    {
+        return reader.string(b & 0x1f, value);
+    }
+
+    switch (b) {
+    case 0xc0:
+        value = Json::Value();
+        return true;
+    case 0xc2:
+        value = false;
+        return true;
+    case 0xc3:
+        value = true;
+        return true;
+    case 0xc4:
+    case 0xd9:
+        return reader.bigEndian(v, 1) && reader.string(v, value);
+    case 0xc5:
+    case 0xda:
+        return reader.bigEndian(v, 2) && reader.string(v, value);
+    case 0xc6:
+    case 0xdb:
+        return reader.bigEndian(v, 4) && reader.string(v, value);
+    case 0xca:
+    {
+        if(!reader.bigEndian(v, 4))
+        {
+            return false;
+        }
+        uint32_t bits = (uint32_t)v;
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        value = (double)f;
+        return true;
+    }
+    case 0xcb:
+    {
+        if(!reader.bigEndian(v, 8))
+        {
+            return false;
+        }
+        double d;
+        std::memcpy(&d, &v, sizeof(d));
+        value = d;
+        return true;
+    }
+    case 0xcc:
+    case 0xcd:
+    case 0xce:
+    case 0xcf:
+        if(!reader.bigEndian(v, 1 << (b - 0xcc)))
+        {
+            return false;
+        }
+        value = makeUnsigned(v);
+        return true;
+    case 0xd0:
+        if(!reader.bigEndian(v, 1))
+        {
+            return false;
+        }
+        value = makeInteger((int8_t)v);
+        return true;
+    case 0xd1:
+        if(!reader.bigEndian(v, 2))
+        {
+            return false;
+        }
+        value = makeInteger((int16_t)v);
+        return true;
+    case 0xd2:
+        if(!reader.bigEndian(v, 4))
+        {
+            return false;
+        }
+        value = makeInteger((int32_t)v);
+        return true;
+    case 0xd3:
+        if(!reader.bigEndian(v, 8))
+        {
+            return false;
+        }
+        value = makeInteger((int64_t)v);
+        return true;
+    case 0xdc:
+        return reader.bigEndian(v, 2) && msgpackDecodeArray(reader, v, value, depth);
+    case 0xdd:
+        return reader.bigEndian(v, 4) && msgpackDecodeArray(reader, v, value, depth);
+    case 0xde:
+        return reader.bigEndian(v, 2) && msgpackDecodeMap(reader, v, value, depth);
+    case 0xdf:
+        return reader.bigEndian(v, 4) && msgpackDecodeMap(reader, v, value, depth);
+    default:
+        //extension types are not used by the protocol
+        return false;
+    }
+}
+
+/***
+ *  CBOR
+ */
+
+void cborHead(std::string& out, uint8_t major, uint64_t v)
+{
+    major = major << 5;
+    if(v < 24)
+    {
+        out.push_back((char)(major | v));
+    }
+    else if(v <= UINT8_MAX)
+    {
+        out.push_back((char)(major | 24));
+        appendBigEndian(out, v, 1);
+    }
+    else if(v <= UINT16_MAX)
+    {
+        out.push_back((char)(major | 25));
+        appendBigEndian(out, v, 2);
+    }
+    else if(v <= UINT32_MAX)
+    {
+        out.push_back((char)(major | 26));
+        appendBigEndian(out, v, 4);
+    }
+    else
+    {
+        out.push_back((char)(major | 27));
+        appendBigEndian(out, v, 8);
+    }
+}
+
+bool cborDecode(PayloadReader& reader, Json::Value& value, int depth)
+{
+    uint8_t b;
+    if(depth > maxDepth || !reader.byte(b))
+    {
+        return false;
+    }
+
+    uint8_t major = b >> 5;
+    uint8_t info = b & 0x1f;
+    uint64_t arg = info;
+    if(info >= 24 && info <= 27)
+    {
+        if(!reader.bigEndian(arg, 1 << (info - 24)))
+        {
+            return false;
+        }
+    }
+    else if(info > 27)
+    {
+        //indefinite lengths and reserved values
+        return false;
+    }
+
+    switch (major) {
+    case 0:
+        value = makeUnsigned(arg);
+        return true;
+    case 1:
+        if(arg > (uint64_t)INT64_MAX)
+        {
+            return false;
+        }
+        value = makeInteger(-1 - (int64_t)arg);
+        return true;
+    case 2:
+    case 3:
+        return reader.string(arg, value);
+    case 4:
+        if(!reader.canHold(arg))
+        {
+            return false;
+        }
+        value = Json::Value(Json::arrayValue);
+        for(uint64_t i = 0; i<arg; i++)
+        {
+            if(!cborDecode(reader, value[(Json::ArrayIndex)i], depth+1))
+            {
+                return false;
+            }
+        }
+        return true;
+    case 5:
+    {
+        if(!reader.canHold(arg))
+        {
+            return false;
+        }
+        value = Json::Value(Json::objectValue);
+        Json::Value key;
+        for(uint64_t i = 0; i<arg; i++)
+        {
+            if(!cborDecode(reader, key, depth+1) || !key.isString() || !cborDecode(reader, value[key.asString()], depth+1))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+    case 6:
+        //the tags are ignored, only the tagged item is kept
+        return cborDecode(reader, value, depth+1);
+    default:
+        break;
+    }
+
+    switch (info) {
+    case 20:
+        value = false;
+        return true;
+    case 21:
+        value = true;
+        return true;
+    case 22:
+    case 23:
+        value = Json::Value();
+        return true;
+    case 25:
+    {
+        //half precision float
+        int exponent = (arg >> 10) & 0x1f;
+        double mantissa = arg & 0x3ff;
+        double magnitude;
+        if(exponent == 0)
+        {
+            magnitude = std::ldexp(mantissa, -24);
+        }
+        else if(exponent == 31)
+        {
+            magnitude = mantissa == 0 ? INFINITY : NAN;
+        }
+        else
+        {
+            magnitude = std::ldexp(mantissa + 1024, exponent - 25);
+        }
+        value = (arg & 0x8000) ? -magnitude : magnitude;
+        return true;
+    }
+    case 26:
+    {
+        uint32_t bits = (uint32_t)arg;
+        float f;
+        std::memcpy(&f, &bits, sizeof(f));
+        value = (double)f;
+        return true;
+    }
+    case 27:
+    {
+        double d;
+        std::memcpy(&d, &arg, sizeof(d));
+        value = d;
+        return true;
+    }
+    default:
+        return false;
+    }
+}
+
+}
+
+const std::string &MessagePackCodec::getSubprotocol() const
+{
+    static const std::string subprotocol("instantinterface.msgpack");
+    return subprotocol;
+}
+
+bool MessagePackCodec::isBinary() const
+{
+    return true;
+}
+
+bool MessagePackCodec::encode(const std::string &json, std::string &payload) const
+{
+    Json::Value value;
+    if(!parseJson(json, value))
+    {
+        return false;
+    }
+    payload.clear();
+    encodeValue(value, payload);
+    return true;
+}
+
+bool MessagePackCodec::decode(const std::string &payload, Json::Value &message) const
+{
+    PayloadReader reader(payload);
+    return msgpackDecode(reader, message, 0) && reader.atEnd();
+}
+
+void MessagePackCodec::encodeValue(const Json::Value &value, std::string &payload)
+{
+    switch (value.type()) {
+    case Json::nullValue:
+        payload.push_back((char)0xc0);
+        break;
+    case Json::booleanValue:
+        payload.push_back(value.asBool() ? (char)0xc3 : (char)0xc2);
+        break;
+    case Json::intValue:
+        msgpackSigned(payload, value.asInt64());
+        break;
+    case Json::uintValue:
+        msgpackUnsigned(payload, value.asUInt64());
+        break;
+    case Json::realValue:
+        payload.push_back((char)0xcb);
+        appendBigEndian(payload, doubleBits(value.asDouble()), 8);
+        break;
+    case Json::stringValue:
+    {
+        const std::string str = value.asString();
+        msgpackHeader(payload, str.size(), 0xa0, 32, 0xd9, 0xda);
+        payload.append(str);
+        break;
+    }
+    case Json::arrayValue:
+        msgpackHeader(payload, value.size(), 0x90, 16, 0, 0xdc);
+        for(const auto& item: value)
+        {
+            encodeValue(item, payload);
+        }
+        break;
+    case Json::objectValue:
+        msgpackHeader(payload, value.size(), 0x80, 16, 0, 0xde);
+        for(auto it = value.begin(); it != value.end(); it++)
+        {
+            const std::string key = it.name();
+            msgpackHeader(payload, key.size(), 0xa0, 32, 0xd9, 0xda);
+            payload.append(key);
+            encodeValue(*it, payload);
+        }
+        break;
+    }
+}
+
+const std::string &CborCodec::getSubprotocol() const
+{
+    static const std::string subprotocol("instantinterface.cbor");
+    return subprotocol;
+}
+
+bool CborCodec::isBinary() const
+{
+    return true;
+}
+
+bool CborCodec::encode(const std::string &json, std::string &payload) const
+{
+    Json::Value value;
+    if(!parseJson(json, value))
+    {
+        return false;
+    }
+    payload.clear();
+    encodeValue(value, payload);
+    return true;
+}
+
+bool CborCodec::decode(const std::string &payload, Json::Value &message) const
+{
+    PayloadReader reader(payload);
+    return cborDecode(reader, message, 0) && reader.atEnd();
+}
+
+void CborCodec::encodeValue(const Json::Value &value, std::string &payload)
+{
+    switch (value.type()) {
+    case Json::nullValue:
+        payload.push_back((char)0xf6);
+        break;
+    case Json::booleanValue:
+        payload.push_back(value.asBool() ? (char)0xf5 : (char)0xf4);
+        break;
+    case Json::intValue:
+    {
+        int64_t v = value.asInt64();
+        if(v >= 0)
+        {
+            cborHead(payload, 0, v);
+        }
+        else
+        {
+            cborHead(payload, 1, (uint64_t)(-(v+1)));
+        }
+        break;
+    }
+    case Json::uintValue:
+        cborHead(payload, 0, value.asUInt64());
+        break;
+    case Json::realValue:
+        payload.push_back((char)0xfb);
+        appendBigEndian(payload, doubleBits(value.asDouble()), 8);
+        break;
+    case Json::stringValue:
+    {
+        const std::string str = value.asString();
+        cborHead(payload, 3, str.size());
+        payload.append(str);
+        break;
+    }
+    case Json::arrayValue:
+        cborHead(payload, 4, value.size());
+        for(const auto& item: value)
+        {
+            encodeValue(item, payload);
+        }
+        break;
+    case Json::objectValue:
+        cborHead(payload, 5, value.size());
+        for(auto it = value.begin(); it != value.end(); it++)
+        {
+            const std::string key = it.name();
+            cborHead(payload, 3, key.size());
+            payload.append(key);
+            encodeValue(*it, payload);
+        }
+        break;
+    }
+}
+
+}
@@ -0,0 +1,114 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+#pragma once
+
+#include <memory>
+#include <string>
+
+namespace Json{
+class Value;
+}
+
+namespace InstantInterface {
+
+/**
+ * @brief The WireCodec class defines an encoding of the messages exchanged with the clients, other than the default json.
+ * The messages (structure, values, commands) are always produced in json; a codec converts each of them once for all the
+ * clients that selected it, and decodes the messages of these clients into json values.
+ * The codecs are selected by the websocket subprotocol requested by the client (see WebInterface::addWireCodec()).
+ * encode() and decode() can be called from several threads at the same time.
+ */
+class WireCodec
+{
+public:
+    virtual ~WireCodec() {}
+
+    /**
+     * @brief returns the name of the websocket subprotocol selecting the codec
+     */
+    virtual const std::string& getSubprotocol() const = 0;
+
+    /**
+     * @brief returns true if the encoded messages are sent in binary frames, false for text frames
+     */
+    virtual bool isBinary() const = 0;
+
+    /**
+     * @brief encodes the json message \p json into \p payload, whose memory is reused
+     * @return false if \p json can't be encoded
+     */
+    virtual bool encode(const std::string& json, std::string& payload) const = 0;
+
+    /**
+     * @brief decodes the received \p payload into \p message
+     * @return false if \p payload is not a valid message
+     */
+    virtual bool decode(const std::string& payload, Json::Value& message) const = 0;
+};
+
+/**
+ * @brief MessagePack codec (subprotocol "instantinterface.msgpack")
+ */
+class MessagePackCodec : public WireCodec
+{
+public:
+    const std::string& getSubprotocol() const;
+    bool isBinary() const;
+    bool encode(const std::string& json, std::string& payload) const;
+    bool decode(const std::string& payload, Json::Value& message) const;
+
+    /**
+     * @brief encodes \p value at the end of \p payload
+     */
+    static void encodeValue(const Json::Value& value, std::string& payload);
+};
+
+/**
+ * @brief CBOR codec, RFC 7049 (subprotocol "instantinterface.cbor"). The indefinite lengths are not supported.
+ */
+class CborCodec : public WireCodec
+{
+public:
+    const std::string& getSubprotocol() const;
+    bool isBinary() const;
+    bool encode(const std::string& json, std::string& payload) const;
+    bool decode(const std::string& payload, Json::Value& message) const;
+
+    /**
+     * @brief encodes \p value at the end of \p payload
+     */
+    static void encodeValue(const Json::Value& value, std::string& payload);
+};
+
+}
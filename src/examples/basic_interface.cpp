@@ -145,6 +145,10 @@ int main(int argc, char* argv[])
     //start server
     s.init(port);
 
+    //the server sends the new values of the parameters to the clients 20 times per second (so that the modifications made by one
+    // are visible by the others). This way the browsers are not overloaded, whatever the frequency of the loop below.
+    s.setBroadcastRate(20);
+
     // starts the server (it is a blocking call if the withThread == false)
     s.run();
 
@@ -152,13 +156,10 @@ int main(int argc, char* argv[])
     {
         //execute the modifications coming from the clients
         s.executeCommands();
-        //update the cache of the parameters (it is required as the mode is threaded)
+        //update the cache of the parameters (it is required as the mode is threaded), it will be sent at the next broadcast
         s.updateParameterCache();
-        //send the new values of the parameters to the clients (so that the modifications made by one
-        // are visible by the others)
-        s.forceRefreshAll();
-        //limit the the frequency of the updates, because otherwise the browsers are overloaded
-        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        //sleep until the next command arrives (at most 30 ms)
+        s.waitForCommands(std::chrono::milliseconds(30));
 
         //There you can write your own code
     }
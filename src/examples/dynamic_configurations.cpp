@@ -184,6 +184,13 @@ int main(int argc, char* argv[])
 
     s.init(port);
 
+    //the transitions modify only a few attributes at a time, so we only send the values that have changed
+    s.setDeltaRefresh(true);
+    //the values are sent by the server 20 times per second
+    s.setBroadcastRate(20);
+    //a slider drag sends many values per frame, only the last one is applied
+    s.setUpdateCoalescing(true);
+
     auto lastApply = std::chrono::system_clock::now();
     auto currentApply  = std::chrono::system_clock::now();
     std::chrono::duration<double> elapsed_seconds;
@@ -204,9 +211,9 @@ int main(int argc, char* argv[])
 
         s.executeCommands();
         s.updateParameterCache();
-        s.forceRefreshAll();
 
-        std::this_thread::sleep_for(std::chrono::milliseconds(30));
+        //the transitions are still applied at least every 30 ms, the commands are applied as soon as they arrive
+        s.waitForCommands(std::chrono::milliseconds(30));
     }
 
     s.stop();
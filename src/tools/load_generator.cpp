@@ -0,0 +1,564 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+#include <InstantInterface/Metrics.h>
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <json/json.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace InstantInterface;
+
+/** @file
+  * @brief load generator simulating many browsers connected to a WebInterface: each client downloads the interface,
+  * then drags the sliders and presses the actions at a fixed rate. The throughput, the latency of the edits
+  * (until their acknowledgement by a broadcast), the traffic and the memory of the server are reported periodically.
+  *
+  * Usage: load_generator [--host localhost] [--port 9000] [--clients 10] [--rate 20] [--duration 30]
+  *                       [--pattern slider|action|mixed] [--pid PID_OF_THE_SERVER] [--report 1]
+  */
+
+typedef websocketpp::client<websocketpp::config::asio_client> client;
+typedef std::chrono::steady_clock clock_type;
+
+struct Options
+{
+    Options() : host("localhost"), port(9000), clients(10), rate(20), duration(30), pattern("mixed"), pid(0), report(1) {}
+
+    std::string host;
+    int port;
+    int clients;
+    // edits sent per second by each client
+    double rate;
+    // seconds, 0 to run until interrupted
+    double duration;
+    std::string pattern;
+    // process of the server whose memory is reported, 0 if none
+    int pid;
+    // seconds between two reports
+    double report;
+};
+
+/**
+ * @brief element of the interface edited by the simulated clients
+ */
+struct Control
+{
+    std::string id;
+    char valueType;
+    double min;
+    double max;
+};
+
+/**
+ * @brief state of one simulated browser, only accessed from the thread of the client endpoint
+ */
+struct SimulatedClient
+{
+    SimulatedClient() : opened(false), ready(false), seq(0), position(0), direction(1), toggle(false), next(0) {}
+
+    websocketpp::connection_hdl hdl;
+    bool opened;
+    // true once the interface has been received
+    bool ready;
+    clock_type::time_point openedAt;
+
+    std::vector<Control> sliders;
+    std::vector<Control> actions;
+
+    // sequence number of the last edit, and the edits waiting for their acknowledgement
+    uint64_t seq;
+    std::deque<std::pair<uint64_t, clock_type::time_point>> inFlight;
+
+    // position of the slider being dragged between 0 and 1
+    double position;
+    double direction;
+    bool toggle;
+    size_t next;
+
+    clock_type::time_point nextEdit;
+    client::timer_ptr timer;
+};
+
+/**
+ * @brief counters of a reporting interval
+ */
+struct Statistics
+{
+    Statistics() : edits(0), acknowledged(0), updates(0), failures(0), bytesReceived(0), bytesSent(0) {}
+
+    void reset()
+    {
+        edits = acknowledged = updates = failures = bytesReceived = bytesSent = 0;
+        latency.reset();
+    }
+
+    uint64_t edits;
+    uint64_t acknowledged;
+    uint64_t updates;
+    uint64_t failures;
+    uint64_t bytesReceived;
+    uint64_t bytesSent;
+    LatencyHistogram latency;
+};
+
+class LoadGenerator
+{
+public:
+    LoadGenerator(const Options& options) : options(options), clients(options.clients), random(std::random_device()()),
+        openCount(0), initialMemory(0)
+    {
+        endpoint.clear_access_channels(websocketpp::log::alevel::all);
+        endpoint.clear_error_channels(websocketpp::log::elevel::all);
+        endpoint.init_asio();
+
+        using websocketpp::lib::placeholders::_1;
+        using websocketpp::lib::placeholders::_2;
+        using websocketpp::lib::bind;
+        endpoint.set_open_handler(bind(&LoadGenerator::on_open, this, _1));
+        endpoint.set_close_handler(bind(&LoadGenerator::on_close, this, _1));
+        endpoint.set_fail_handler(bind(&LoadGenerator::on_fail, this, _1));
+        endpoint.set_message_handler(bind(&LoadGenerator::on_message, this, _1, _2));
+    }
+
+    void run()
+    {
+        std::string uri = "ws://" + options.host + ":" + std::to_string(options.port) + "/";
+        for(size_t i = 0; i<clients.size(); i++)
+        {
+            websocketpp::lib::error_code ec;
+            client::connection_ptr con = endpoint.get_connection(uri, ec);
+            if(ec)
+            {
+                std::cout << "couldn't create the connection to " << uri << ": " << ec.message() << std::endl;
+                return;
+            }
+            clients[i].hdl = con;
+            indices[con] = i;
+            endpoint.connect(con);
+        }
+
+        start = clock_type::now();
+        lastReport = start;
+        initialMemory = readMemory();
+        scheduleReport();
+
+        endpoint.run();
+
+        std::cout << std::endl << "total over " << secondsSince(start) << " s:" << std::endl;
+        printStatistics(total, secondsSince(start));
+        std::cout << "handshake: ";
+        handshake.dump(std::cout);
+        std::cout << std::endl;
+    }
+
+private:
+    SimulatedClient* find(websocketpp::connection_hdl hdl)
+    {
+        auto it = indices.find(hdl);
+        return it == indices.end() ? nullptr : &clients[it->second];
+    }
+
+    void on_open(websocketpp::connection_hdl hdl)
+    {
+        SimulatedClient* simulated = find(hdl);
+        if(!simulated)
+        {
+            return;
+        }
+        simulated->opened = true;
+        simulated->openedAt = clock_type::now();
+        openCount++;
+        send(*simulated, "send_interface");
+    }
+
+    void on_close(websocketpp::connection_hdl hdl)
+    {
+        SimulatedClient* simulated = find(hdl);
+        if(simulated && simulated->opened)
+        {
+            simulated->opened = false;
+            simulated->ready = false;
+            openCount--;
+            if(simulated->timer)
+            {
+                simulated->timer->cancel();
+            }
+        }
+    }
+
+    void on_fail(websocketpp::connection_hdl /*hdl*/)
+    {
+        interval.failures++;
+        total.failures++;
+    }
+
+    void on_message(websocketpp::connection_hdl hdl, client::message_ptr msg)
+    {
+        SimulatedClient* simulated = find(hdl);
+        if(!simulated)
+        {
+            return;
+        }
+        const std::string& payload = msg->get_payload();
+        interval.bytesReceived += payload.size();
+        total.bytesReceived += payload.size();
+
+        Json::Reader reader;
+        Json::Value message;
+        if(!reader.parse(payload, message) || !message.isObject())
+        {
+            return;
+        }
+
+        const std::string type = message["type"].asString();
+        if(type == "interface")
+        {
+            handshake.record(clock_type::now() - simulated->openedAt);
+            simulated->sliders.clear();
+            simulated->actions.clear();
+            collectControls(message["content"], *simulated);
+            if(!simulated->ready)
+            {
+                simulated->ready = true;
+                //the clients don't edit in phase
+                std::uniform_real_distribution<double> offset(0.0, 1.0/options.rate);
+                simulated->nextEdit = clock_type::now() + std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(offset(random)));
+                scheduleEdits(*simulated);
+            }
+        }
+        else if(type == "update")
+        {
+            interval.updates++;
+            total.updates++;
+        }
+        else if(type == "ack")
+        {
+            uint64_t seq = message["seq"].asUInt64();
+            auto now = clock_type::now();
+            //the acknowledgements are coalesced: one acknowledgement covers all the previous edits of the client
+            while(!simulated->inFlight.empty() && simulated->inFlight.front().first <= seq)
+            {
+                interval.latency.record(now - simulated->inFlight.front().second);
+                total.latency.record(now - simulated->inFlight.front().second);
+                interval.acknowledged++;
+                total.acknowledged++;
+                simulated->inFlight.pop_front();
+            }
+        }
+    }
+
+    void collectControls(const Json::Value& content, SimulatedClient& simulated)
+    {
+        if(!content.isArray())
+        {
+            return;
+        }
+        for(const Json::Value& node: content)
+        {
+            const std::string type = node["type"].asString();
+            if(type == "group")
+            {
+                collectControls(node["content"], simulated);
+                continue;
+            }
+            const std::string valueType = node["valueType"].asString();
+            if(type != "parameter" || valueType.size() != 1)
+            {
+                continue;
+            }
+
+            Control control;
+            control.id = node["id"].asString();
+            control.valueType = valueType[0];
+            control.min = node.isMember("min") ? node["min"].asDouble() : 0;
+            control.max = node.isMember("max") ? node["max"].asDouble() : 100;
+            if(control.valueType == 'i' || control.valueType == 'f' || control.valueType == 'd')
+            {
+                simulated.sliders.push_back(control);
+            }
+            else if(control.valueType == 'a' || control.valueType == 'b')
+            {
+                simulated.actions.push_back(control);
+            }
+        }
+    }
+
+    void scheduleEdits(SimulatedClient& simulated)
+    {
+        long delay = std::max(0L, (long)std::chrono::duration_cast<std::chrono::milliseconds>(simulated.nextEdit - clock_type::now()).count());
+        websocketpp::connection_hdl hdl = simulated.hdl;
+        simulated.timer = endpoint.set_timer(delay, [this, hdl](const websocketpp::lib::error_code& ec)
+        {
+            SimulatedClient* simulated = find(hdl);
+            if(ec || !simulated || !simulated->ready)
+            {
+                return;
+            }
+            //the deadlines are computed from the previous ones, several edits are sent if the timer is late (high rates)
+            auto period = std::chrono::duration_cast<clock_type::duration>(std::chrono::duration<double>(1.0/options.rate));
+            auto now = clock_type::now();
+            while(simulated->nextEdit <= now)
+            {
+                sendEdit(*simulated);
+                simulated->nextEdit += period;
+            }
+            scheduleEdits(*simulated);
+        });
+    }
+
+    void sendEdit(SimulatedClient& simulated)
+    {
+        bool slider = options.pattern == "slider" || (options.pattern == "mixed" && std::uniform_int_distribution<int>(0, 9)(random) != 0);
+        const std::vector<Control>* chosen = slider ? &simulated.sliders : &simulated.actions;
+        if(chosen->empty())
+        {
+            //the interface has no control of this kind
+            chosen = slider ? &simulated.actions : &simulated.sliders;
+        }
+        const std::vector<Control>& controls = *chosen;
+        if(controls.empty())
+        {
+            return;
+        }
+
+        Json::Value message;
+        message["type"] = "update";
+        message["seq"] = Json::UInt64(++simulated.seq);
+        Json::Value edit;
+
+        if(&controls == &simulated.sliders)
+        {
+            //drags the same slider back and forth, then moves to the next one
+            const Control& control = controls[simulated.next % controls.size()];
+            simulated.position += simulated.direction * 0.05;
+            if(simulated.position >= 1 || simulated.position <= 0)
+            {
+                simulated.position = std::min(1.0, std::max(0.0, simulated.position));
+                simulated.direction = -simulated.direction;
+                simulated.next++;
+            }
+            double value = control.min + simulated.position * (control.max - control.min);
+            edit["id"] = control.id;
+            if(control.valueType == 'i')
+            {
+                edit["value"] = (int)std::lround(value);
+            }
+            else
+            {
+                edit["value"] = value;
+            }
+        }
+        else
+        {
+            const Control& control = controls[std::uniform_int_distribution<size_t>(0, controls.size()-1)(random)];
+            edit["id"] = control.id;
+            if(control.valueType == 'b')
+            {
+                simulated.toggle = !simulated.toggle;
+                edit["value"] = simulated.toggle;
+            }
+            else
+            {
+                edit["value"] = Json::Value::null;
+            }
+        }
+        message["content"].append(edit);
+
+        Json::FastWriter writer;
+        simulated.inFlight.emplace_back(simulated.seq, clock_type::now());
+        send(simulated, writer.write(message));
+        interval.edits++;
+        total.edits++;
+    }
+
+    void send(SimulatedClient& simulated, const std::string& payload)
+    {
+        websocketpp::lib::error_code ec;
+        endpoint.send(simulated.hdl, payload, websocketpp::frame::opcode::text, ec);
+        if(!ec)
+        {
+            interval.bytesSent += payload.size();
+            total.bytesSent += payload.size();
+        }
+    }
+
+    void scheduleReport()
+    {
+        reportTimer = endpoint.set_timer((long)(options.report*1000), [this](const websocketpp::lib::error_code& ec)
+        {
+            if(ec)
+            {
+                return;
+            }
+            auto now = clock_type::now();
+            std::cout << "t=" << (long)secondsSince(start) << "s ";
+            printStatistics(interval, std::chrono::duration<double>(now - lastReport).count());
+            lastReport = now;
+
+            interval.reset();
+
+            if(options.duration > 0 && secondsSince(start) >= options.duration)
+            {
+                finish();
+                return;
+            }
+            scheduleReport();
+        });
+    }
+
+    void finish()
+    {
+        for(auto& simulated: clients)
+        {
+            simulated.ready = false;
+            if(simulated.timer)
+            {
+                simulated.timer->cancel();
+            }
+            websocketpp::lib::error_code ec;
+            endpoint.close(simulated.hdl, websocketpp::close::status::going_away, "load test finished", ec);
+        }
+    }
+
+    void printStatistics(const Statistics& statistics, double seconds)
+    {
+        seconds = std::max(seconds, 1e-3);
+        long memory = readMemory();
+        char line[512];
+        snprintf(line, sizeof(line), "clients=%d/%d edits=%.0f/s acked=%.0f/s updates=%.0f/s in=%.1f kB/s out=%.1f kB/s failures=%llu "
+                 "latency p50=%.2f p90=%.2f p99=%.2f max=%.2f ms",
+                 openCount, options.clients, statistics.edits/seconds, statistics.acknowledged/seconds, statistics.updates/seconds,
+                 statistics.bytesReceived/seconds/1000, statistics.bytesSent/seconds/1000, (unsigned long long)statistics.failures,
+                 statistics.latency.getPercentileSeconds(50)*1000, statistics.latency.getPercentileSeconds(90)*1000,
+                 statistics.latency.getPercentileSeconds(99)*1000, statistics.latency.getMaxSeconds()*1000);
+        std::cout << line;
+        if(memory >= 0)
+        {
+            std::cout << " server rss=" << memory/1024 << " MB (" << (memory >= initialMemory ? "+" : "") << (memory - initialMemory)/1024 << " MB)";
+        }
+        std::cout << std::endl;
+    }
+
+    /**
+     * @brief returns the resident memory of the server in kB, -1 if unknown (no pid given, or not on Linux)
+     */
+    long readMemory()
+    {
+        if(options.pid <= 0)
+        {
+            return -1;
+        }
+        std::ifstream status("/proc/" + std::to_string(options.pid) + "/status");
+        std::string line;
+        while(std::getline(status, line))
+        {
+            if(line.compare(0, 6, "VmRSS:") == 0)
+            {
+                return std::atol(line.c_str() + 6);
+            }
+        }
+        return -1;
+    }
+
+    double secondsSince(clock_type::time_point time)
+    {
+        return std::chrono::duration<double>(clock_type::now() - time).count();
+    }
+
+    Options options;
+    client endpoint;
+    std::vector<SimulatedClient> clients;
+    std::map<websocketpp::connection_hdl, size_t, std::owner_less<websocketpp::connection_hdl>> indices;
+    std::mt19937 random;
+
+    int openCount;
+    long initialMemory;
+    clock_type::time_point start;
+    clock_type::time_point lastReport;
+    client::timer_ptr reportTimer;
+
+    Statistics interval;
+    Statistics total;
+    LatencyHistogram handshake;
+};
+
+
+int main(int argc, char* argv[])
+{
+    Options options;
+    for(int i = 1; i+1<argc; i += 2)
+    {
+        std::string name = argv[i];
+        std::string value = argv[i+1];
+        if(name == "--host") { options.host = value; }
+        else if(name == "--port") { options.port = std::atoi(value.c_str()); }
+        else if(name == "--clients") { options.clients = std::atoi(value.c_str()); }
+        else if(name == "--rate") { options.rate = std::atof(value.c_str()); }
+        else if(name == "--duration") { options.duration = std::atof(value.c_str()); }
+        else if(name == "--pattern") { options.pattern = value; }
+        else if(name == "--pid") { options.pid = std::atoi(value.c_str()); }
+        else if(name == "--report") { options.report = std::atof(value.c_str()); }
+        else
+        {
+            std::cout << "unknown option " << name << std::endl;
+            return 1;
+        }
+    }
+    if(argc % 2 == 0 || options.clients <= 0 || options.rate <= 0 || options.report <= 0 ||
+       (options.pattern != "slider" && options.pattern != "action" && options.pattern != "mixed"))
+    {
+        std::cout << "usage: load_generator [--host localhost] [--port 9000] [--clients 10] [--rate 20] [--duration 30]"
+                     " [--pattern slider|action|mixed] [--pid PID_OF_THE_SERVER] [--report 1]" << std::endl;
+        return 1;
+    }
+
+    LoadGenerator generator(options);
+    generator.run();
+
+    return 0;
+}
@@ -0,0 +1,110 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+//Link to Boost
+ #define BOOST_TEST_DYN_LINK
+
+//Define our Module name (prints at testing)
+ #define BOOST_TEST_MODULE "AssetCacheTest"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <InstantInterface/AssetCache.h>
+
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+using namespace InstantInterface;
+namespace fs = boost::filesystem;
+
+BOOST_AUTO_TEST_SUITE(TestOfAssetCache)
+
+void writeFile(const fs::path& path, const std::string& content)
+{
+    std::ofstream file(path.string().c_str(), std::ios::out | std::ios::binary);
+    file<<content;
+}
+
+BOOST_AUTO_TEST_CASE(LoadAndFind)
+{
+    fs::path root = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(root / "js");
+
+    std::string script;
+    for(int i = 0; i<200; i++)
+    {
+        script += "var value" + std::to_string(i) + " = " + std::to_string(i) + ";\n";
+    }
+    writeFile(root / "index.html", "<html></html>");
+    writeFile(root / "js" / "bundle.js", script);
+
+    AssetCache cache;
+    BOOST_CHECK_EQUAL(cache.load(root.string() + "/"), 2u);
+
+    auto index = cache.find("/");
+    BOOST_REQUIRE(index);
+    BOOST_CHECK_EQUAL(index->body, "<html></html>");
+    BOOST_CHECK_EQUAL(index->contentType, "text/html; charset=utf-8");
+    //too small to be worth compressing
+    BOOST_CHECK(index->gzipBody.empty());
+
+    auto bundle = cache.find("/js/bundle.js?v=2");
+    BOOST_REQUIRE(bundle);
+    BOOST_CHECK_EQUAL(bundle->body, script);
+    BOOST_CHECK_EQUAL(bundle->contentType, "application/javascript; charset=utf-8");
+    BOOST_CHECK(!bundle->gzipBody.empty() && bundle->gzipBody.size() < script.size());
+    BOOST_CHECK(!bundle->deflateBody.empty());
+    BOOST_CHECK(!bundle->etag.empty() && bundle->etag != index->etag);
+    BOOST_CHECK(!bundle->lastModified.empty());
+
+    BOOST_CHECK(!cache.find("/missing.js"));
+    BOOST_CHECK(!cache.find("/../index.html"));
+
+    //without reloading, the changes on disk are ignored
+    writeFile(root / "index.html", "<html>changed</html>");
+    BOOST_CHECK_EQUAL(cache.find("/index.html")->body, "<html></html>");
+
+    cache.setRefreshInterval(std::chrono::milliseconds(1));
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    auto changed = cache.find("/index.html");
+    BOOST_CHECK_EQUAL(changed->body, "<html>changed</html>");
+    BOOST_CHECK(changed->etag != index->etag);
+
+    fs::remove_all(root);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
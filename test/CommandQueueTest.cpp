@@ -0,0 +1,128 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+//Link to Boost
+ #define BOOST_TEST_DYN_LINK
+
+//Define our Module name (prints at testing)
+ #define BOOST_TEST_MODULE "CommandQueueTest"
+
+#include <boost/test/unit_test.hpp>
+
+#include <InstantInterface/CommandQueue.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace InstantInterface;
+
+BOOST_AUTO_TEST_SUITE(TestOfCommandQueue)
+
+BOOST_AUTO_TEST_CASE(Overflow)
+{
+    CommandQueue<std::string> queue(3);
+    BOOST_CHECK_EQUAL(queue.capacity(), 4u);
+
+    std::string value;
+    BOOST_CHECK(!queue.pop(value));
+
+    for(int i = 0; i<4; i++)
+    {
+        BOOST_CHECK(queue.push(std::to_string(i)));
+    }
+    BOOST_CHECK(!queue.push("dropped"));
+    BOOST_CHECK_EQUAL(queue.size(), 4u);
+    BOOST_CHECK_EQUAL(queue.getOverflowCount(), 1u);
+
+    //first in, first out, also after the positions have wrapped around
+    for(int lap = 0; lap<3; lap++)
+    {
+        BOOST_REQUIRE(queue.pop(value));
+        BOOST_CHECK_EQUAL(value, std::to_string(lap));
+        BOOST_CHECK(queue.push(std::to_string(lap+4)));
+    }
+    for(int i = 3; i<7; i++)
+    {
+        BOOST_REQUIRE(queue.pop(value));
+        BOOST_CHECK_EQUAL(value, std::to_string(i));
+    }
+    BOOST_CHECK(!queue.pop(value));
+    BOOST_CHECK_EQUAL(queue.size(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(MultipleProducers)
+{
+    const int producerCount = 4;
+    const int valueCount = 20000;
+    CommandQueue<int> queue(64);
+
+    std::vector<std::thread> producers;
+    for(int p = 0; p<producerCount; p++)
+    {
+        producers.emplace_back([&queue, p, valueCount](){
+            for(int i = 0; i<valueCount; i++)
+            {
+                while(!queue.push(p*valueCount+i))
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    //the values of each producer are received in order
+    std::vector<int> next(producerCount, 0);
+    int received = 0;
+    int value;
+    while(received < producerCount*valueCount)
+    {
+        if(queue.pop(value))
+        {
+            int p = value / valueCount;
+            BOOST_REQUIRE_EQUAL(value % valueCount, next[p]);
+            next[p]++;
+            received++;
+        }
+    }
+
+    for(auto& producer: producers)
+    {
+        producer.join();
+    }
+    BOOST_CHECK(!queue.pop(value));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,423 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+//Link to Boost
+ #define BOOST_TEST_DYN_LINK
+
+//Define our Module name (prints at testing)
+ #define BOOST_TEST_MODULE "InterfaceManagerTest"
+
+#include <boost/test/unit_test.hpp>
+
+#include <InstantInterface/InterfaceManager.h>
+#include <InstantInterface/JsonWriter.h>
+#include <InstantInterface/BinaryProtocol.h>
+#include <json/json.h>
+
+#include <string>
+
+using namespace std;
+using namespace InstantInterface;
+using namespace InstantInterface::AttributeFactory;
+
+BOOST_AUTO_TEST_SUITE(TestOfInterfaceManager)
+
+Json::Value parse(const std::string& str)
+{
+    Json::Reader reader;
+    Json::Value json;
+    BOOST_REQUIRE(reader.parse(str, json));
+    return json;
+}
+
+BOOST_AUTO_TEST_CASE(StateDelta)
+{
+    float f = 0;
+    int i = 0;
+    bool b = false;
+
+    //the interface only keeps weak references to the attributes
+    auto fa = makeAttribute(&f);
+    auto ia = makeAttribute(&i);
+    auto ba = makeAttribute(&b);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("f", fa);
+    manager.createGroup("group")
+            .addInteractionElement("i", ia)
+            .addInteractionElement("b", ba)
+            .addInteractionElement("action", makeAction([](){}));
+
+    //the first poll reports all the attributes (but not the action)
+    uint64_t v1 = manager.pollStateChanges();
+    Json::Value delta = parse(manager.getStateDeltaJsonString(0));
+    BOOST_CHECK(delta["type"].asString() == "update");
+    BOOST_CHECK_EQUAL(delta["content"].size(), 3u);
+
+    //nothing changed
+    uint64_t v2 = manager.pollStateChanges();
+    BOOST_CHECK_EQUAL(v1, v2);
+    BOOST_CHECK_EQUAL(parse(manager.getStateDeltaJsonString(v2))["content"].size(), 0u);
+
+    i = 4;
+    uint64_t v3 = manager.pollStateChanges();
+    BOOST_CHECK(v3 > v2);
+    delta = parse(manager.getStateDeltaJsonString(v2));
+    BOOST_REQUIRE_EQUAL(delta["content"].size(), 1u);
+    BOOST_CHECK(delta["content"][0]["id"].asString() == "i");
+    BOOST_CHECK_EQUAL(delta["content"][0]["value"].asInt(), 4);
+
+    //changes are accumulated when the delta is computed from an older version
+    f = 2.5;
+    uint64_t v4 = manager.pollStateChanges();
+    BOOST_CHECK_EQUAL(parse(manager.getStateDeltaJsonString(v2))["content"].size(), 2u);
+    BOOST_CHECK_EQUAL(parse(manager.getStateDeltaJsonString(v3))["content"].size(), 1u);
+    BOOST_CHECK_EQUAL(parse(manager.getStateDeltaJsonString(v4))["content"].size(), 0u);
+
+    //changed elements by handle, with the polled values
+    ElementHandleMap handles;
+    manager.getElementHandles(handles);
+    std::vector<size_t> changed;
+    manager.getChangedElements(changed, v3);
+    BOOST_REQUIRE_EQUAL(changed.size(), 1u);
+    BOOST_CHECK_EQUAL(changed[0], handles["f"].index);
+    BOOST_CHECK_EQUAL(manager.getPolledValueJson(handles["i"].index), "4");
+    BOOST_CHECK_EQUAL(manager.getPolledValueJson(handles["action"].index), "null");
+    BOOST_CHECK(manager.getPolledValueJson(100).empty());
+}
+
+BOOST_AUTO_TEST_CASE(CompactJson)
+{
+    std::string buffer;
+    JsonWriter writer(buffer);
+    writer.beginObject();
+    writer.key("s");
+    writer.value(std::string("a \"quoted\"\n\\ string"));
+    writer.key("f");
+    writer.value(0.3f);
+    writer.key("a");
+    writer.beginArray();
+    writer.value(1);
+    writer.value(true);
+    writer.valueNull();
+    writer.endArray();
+    writer.endObject();
+
+    BOOST_CHECK_EQUAL(buffer, "{\"s\":\"a \\\"quoted\\\"\\n\\\\ string\",\"f\":0.3,\"a\":[1,true,null]}");
+    Json::Value json = parse(buffer);
+    BOOST_CHECK(json["s"].asString() == "a \"quoted\"\n\\ string");
+    BOOST_CHECK_EQUAL(json["f"].asFloat(), 0.3f);
+}
+
+BOOST_AUTO_TEST_CASE(StructureJson)
+{
+    float f = 1.5;
+    int i = 7;
+    auto fa = makeAttribute(&f)->setMin(0)->setMax(2);
+    auto ia = makeAttribute(&i);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("f", fa);
+    auto group = manager.createGroup("group");
+    group.addInteractionElement("i", ia);
+    group.createGroup("empty");
+
+    Json::Value structure = parse(manager.getStructureJsonString());
+    BOOST_CHECK(structure["type"].asString() == "interface");
+    Json::Value& content = structure["content"];
+    BOOST_REQUIRE_EQUAL(content.size(), 2u);
+    BOOST_CHECK(content[0]["id"].asString() == "f");
+    BOOST_CHECK(content[0]["valueType"].asString() == "f");
+    BOOST_CHECK_EQUAL(content[0]["value"].asFloat(), 1.5f);
+    BOOST_CHECK_EQUAL(content[0]["max"].asFloat(), 2.0f);
+    BOOST_CHECK(content[1]["type"].asString() == "group");
+    BOOST_CHECK_EQUAL(content[1]["content"][0]["value"].asInt(), 7);
+    BOOST_CHECK(!content[1]["content"][0].isMember("min"));
+    BOOST_CHECK_EQUAL(content[1]["content"][1]["content"].size(), 0u);
+
+    //without the values, the structure only changes when elements are added
+    std::string withoutValues;
+    manager.writeStructureJson(withoutValues, false);
+    BOOST_CHECK(!parse(withoutValues)["content"][0].isMember("value"));
+    f = 0.5;
+    std::string withoutValues2;
+    manager.writeStructureJson(withoutValues2, false);
+    BOOST_CHECK_EQUAL(withoutValues, withoutValues2);
+
+    Json::Value state = parse(manager.getStateJsonString());
+    BOOST_CHECK(state["type"].asString() == "update");
+    BOOST_CHECK_EQUAL(state["content"].size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(StateByGroup)
+{
+    int a = 1, b = 2, c = 3;
+    auto aa = makeAttribute(&a);
+    auto ba = makeAttribute(&b);
+    auto ca = makeAttribute(&c);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("a", aa);
+    auto group = manager.createGroup("group");
+    group.addInteractionElement("b", ba);
+    group.createGroup("sub").addInteractionElement("c", ca);
+
+    std::vector<std::string> paths = manager.getGroupPaths();
+    BOOST_REQUIRE_EQUAL(paths.size(), 3u);
+    BOOST_CHECK_EQUAL(paths[0], "");
+    BOOST_CHECK_EQUAL(paths[1], "group");
+    BOOST_CHECK_EQUAL(paths[2], "group/sub");
+
+    std::vector<std::string> fragments;
+    manager.writeStateJsonByGroup(fragments);
+    BOOST_REQUIRE_EQUAL(fragments.size(), 3u);
+    BOOST_CHECK_EQUAL(fragments[1], "{\"id\":\"b\",\"value\":2}");
+    BOOST_CHECK_EQUAL(parse("[" + fragments[0] + "," + fragments[2] + "]").size(), 2u);
+
+    uint64_t v = manager.pollStateChanges();
+    BOOST_CHECK(!manager.writeStateDeltaJsonByGroup(fragments, v));
+    c = 4;
+    manager.pollStateChanges();
+    BOOST_CHECK(manager.writeStateDeltaJsonByGroup(fragments, v));
+    BOOST_CHECK(fragments[0].empty());
+    BOOST_CHECK(fragments[1].empty());
+    BOOST_CHECK_EQUAL(fragments[2], "{\"id\":\"c\",\"value\":4}");
+}
+
+BOOST_AUTO_TEST_CASE(UniqueGroupPaths)
+{
+    int a = 1;
+    auto aa = makeAttribute(&a);
+
+    InterfaceManager manager;
+    auto first = manager.createGroup("group");
+    manager.createGroup("group").addInteractionElement("a", aa);
+    manager.createGroup("group/sub");
+    first.createGroup("sub");
+    manager.createGroup("50% #1");
+
+    //the paths identify each group, whatever the names
+    std::vector<std::string> paths = manager.getGroupPaths();
+    BOOST_REQUIRE_EQUAL(paths.size(), 6u);
+    BOOST_CHECK_EQUAL(paths[1], "group");
+    BOOST_CHECK_EQUAL(paths[2], "group#2");
+    BOOST_CHECK_EQUAL(paths[3], "group%2Fsub");
+    BOOST_CHECK_EQUAL(paths[4], "group/sub");
+    BOOST_CHECK_EQUAL(paths[5], "50%25 %231");
+
+    //the structure gives the name and the path of each group
+    Json::Value structure = parse(manager.getStructureJsonString());
+    BOOST_CHECK_EQUAL(structure["content"][1]["name"].asString(), "group");
+    BOOST_CHECK_EQUAL(structure["content"][1]["path"].asString(), "group#2");
+    BOOST_CHECK_EQUAL(structure["content"][1]["content"][0]["id"].asString(), "a");
+    BOOST_CHECK_EQUAL(structure["content"][2]["name"].asString(), "group/sub");
+}
+
+BOOST_AUTO_TEST_CASE(ElementHandles)
+{
+    float f = 0;
+    int i = 0;
+    int actionCount = 0;
+    auto fa = makeAttribute(&f);
+    auto ia = makeAttribute(&i);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("f", fa);
+    manager.createGroup("group")
+            .addInteractionElement("i", ia)
+            .addInteractionElement("action", makeAction([&actionCount](){actionCount++;}));
+
+    ElementHandleMap handles;
+    uint64_t generation = manager.getElementHandles(handles);
+    BOOST_REQUIRE_EQUAL(handles.size(), 3u);
+    BOOST_CHECK_EQUAL(handles["f"].type, TYPE_FLOAT);
+    BOOST_CHECK_EQUAL(handles["i"].type, TYPE_INT);
+    BOOST_CHECK_EQUAL(handles["action"].type, TYPE_UNDEFINED);
+
+    ElementUpdate update;
+    update.handleGeneration = generation;
+    update.handle = handles["i"].index;
+    update.type = TYPE_INT;
+    update.intValue = 5;
+    BOOST_CHECK(manager.applyElementUpdate(update));
+    BOOST_CHECK_EQUAL(i, 5);
+
+    update.handle = handles["action"].index;
+    update.type = TYPE_UNDEFINED;
+    BOOST_CHECK(manager.applyElementUpdate(update));
+    BOOST_CHECK_EQUAL(actionCount, 1);
+
+    //wrong type
+    update.handle = handles["f"].index;
+    BOOST_CHECK(!manager.applyElementUpdate(update));
+
+    //the handles are invalidated by clear()
+    manager.clear();
+    BOOST_CHECK(manager.getHandleGeneration() != generation);
+    update.type = TYPE_FLOAT;
+    BOOST_CHECK(!manager.applyElementUpdate(update));
+}
+
+BOOST_AUTO_TEST_CASE(StructurePatch)
+{
+    int i = 0;
+    float f = 0;
+    auto ia = makeAttribute(&i);
+    auto fa = makeAttribute(&f);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("i", ia);
+    uint64_t revision = manager.getStructureRevision();
+
+    manager.createGroup("group").addInteractionElement("f", fa);
+    BOOST_CHECK_EQUAL(manager.getStructureRevision(), revision+2);
+
+    std::string buffer;
+    BOOST_REQUIRE(manager.writeStructurePatchJson(buffer, revision));
+    Json::Value patch = parse(buffer);
+    BOOST_CHECK_EQUAL(patch["type"].asString(), "patch");
+    BOOST_REQUIRE_EQUAL(patch["content"].size(), 2u);
+    BOOST_CHECK_EQUAL(patch["content"][0]["group"].asString(), "");
+    BOOST_CHECK_EQUAL(patch["content"][0]["node"]["name"].asString(), "group");
+    BOOST_CHECK_EQUAL(patch["content"][0]["node"]["content"].size(), 0u);
+    BOOST_CHECK_EQUAL(patch["content"][1]["group"].asString(), "group");
+    BOOST_CHECK_EQUAL(patch["content"][1]["node"]["name"].asString(), "f");
+
+    //edits that are no longer in the journal
+    manager.setStructureJournalCapacity(1);
+    manager.addInteractionElement("j", ia);
+    BOOST_CHECK(!manager.writeStructurePatchJson(buffer, revision));
+    BOOST_CHECK(manager.writeStructurePatchJson(buffer, manager.getStructureRevision()-1));
+
+    //clear() can't be described by a patch
+    revision = manager.getStructureRevision();
+    manager.clear();
+    BOOST_CHECK(!manager.writeStructurePatchJson(buffer, revision));
+}
+
+BOOST_AUTO_TEST_CASE(StructurePatchGroupPath)
+{
+    int i = 0;
+    float f = 0;
+    auto ia = makeAttribute(&i);
+    auto fa = makeAttribute(&f);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("i", ia);
+    uint64_t revision = manager.getStructureRevision();
+
+    //the inserts into the new group refer to it by the path of its node
+    auto group = manager.createGroup("a/b");
+    group.addInteractionElement("f", fa);
+
+    std::string buffer;
+    BOOST_REQUIRE(manager.writeStructurePatchJson(buffer, revision));
+    Json::Value patch = parse(buffer);
+    BOOST_REQUIRE_EQUAL(patch["content"].size(), 2u);
+    const Json::Value& node = patch["content"][0]["node"];
+    BOOST_CHECK_EQUAL(node["type"].asString(), "group");
+    BOOST_REQUIRE(node.isMember("path"));
+    BOOST_CHECK_EQUAL(node["path"].asString(), "a%2Fb");
+    BOOST_CHECK_EQUAL(patch["content"][1]["group"].asString(), node["path"].asString());
+    BOOST_CHECK_EQUAL(patch["content"][1]["node"]["name"].asString(), "f");
+}
+
+BOOST_AUTO_TEST_CASE(BinaryState)
+{
+    int i = -3;
+    float f = 0.25f;
+    double d = 1.5;
+    auto ia = makeAttribute(&i);
+    auto fa = makeAttribute(&f);
+    fa->setMin(0.0f);
+    fa->setMax(1.0f);
+    auto da = makeAttribute(&d);
+
+    InterfaceManager manager;
+    manager.addInteractionElement("i", ia);
+    manager.createGroup("group")
+            .addInteractionElement("f", fa)
+            .addInteractionElement("d", da);
+
+    ElementHandleMap handles;
+    manager.getElementHandles(handles);
+    Json::Value structure = parse(manager.getStructureJsonString());
+    BOOST_CHECK_EQUAL(structure["content"][0]["handle"].asUInt(), handles["i"].index);
+
+    std::vector<std::string> fragments;
+    manager.writeStateBinaryByGroup(fragments, false);
+    BOOST_REQUIRE_EQUAL(fragments.size(), 2u);
+
+    BinaryReader root(fragments[0]);
+    uint32_t handle, intValue;
+    uint8_t tag;
+    BOOST_REQUIRE(root.uint32(handle) && root.uint8(tag) && root.uint32(intValue));
+    BOOST_CHECK_EQUAL(handle, handles["i"].index);
+    BOOST_CHECK_EQUAL(tag, BinaryProtocol::TAG_INT);
+    BOOST_CHECK_EQUAL((int32_t)intValue, -3);
+    BOOST_CHECK(root.atEnd());
+
+    //the records of a group are ordered by id
+    BinaryReader group(fragments[1]);
+    float floatValue;
+    double doubleValue;
+    BOOST_REQUIRE(group.uint32(handle) && group.uint8(tag) && group.float64(doubleValue));
+    BOOST_CHECK_EQUAL(handle, handles["d"].index);
+    BOOST_CHECK_EQUAL(tag, BinaryProtocol::TAG_DOUBLE);
+    BOOST_CHECK_EQUAL(doubleValue, 1.5);
+    BOOST_REQUIRE(group.uint32(handle) && group.uint8(tag) && group.float32(floatValue));
+    BOOST_CHECK_EQUAL(tag, BinaryProtocol::TAG_FLOAT);
+    BOOST_CHECK_EQUAL(floatValue, 0.25f);
+    BOOST_CHECK(group.atEnd());
+
+    //quantized on 16 bits in [min, max]
+    manager.writeStateBinaryByGroup(fragments, true);
+    BinaryReader quantized(fragments[1]);
+    uint16_t q;
+    BOOST_REQUIRE(quantized.uint32(handle) && quantized.uint8(tag) && quantized.float64(doubleValue));
+    BOOST_REQUIRE(quantized.uint32(handle) && quantized.uint8(tag) && quantized.uint16(q));
+    BOOST_CHECK_EQUAL(tag, BinaryProtocol::TAG_QUANTIZED);
+    BOOST_CHECK_CLOSE(BinaryProtocol::dequantize(q, 0.0f, 1.0f), 0.25f, 0.01);
+
+    //delta
+    uint64_t version = manager.pollStateChanges();
+    BOOST_CHECK(!manager.writeStateDeltaBinaryByGroup(fragments, version, false));
+    i = 4;
+    manager.pollStateChanges();
+    BOOST_CHECK(manager.writeStateDeltaBinaryByGroup(fragments, version, false));
+    BOOST_CHECK_EQUAL(fragments[0].size(), 9u);
+    BOOST_CHECK(fragments[1].empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,135 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+//Link to Boost
+ #define BOOST_TEST_DYN_LINK
+
+//Define our Module name (prints at testing)
+ #define BOOST_TEST_MODULE "MetricsTest"
+
+#include <boost/test/unit_test.hpp>
+
+#include <InstantInterface/Metrics.h>
+
+#include <string>
+
+using namespace std;
+using namespace InstantInterface;
+
+BOOST_AUTO_TEST_SUITE(TestOfMetrics)
+
+BOOST_AUTO_TEST_CASE(Durations)
+{
+    DurationCounter counter;
+    counter.add(std::chrono::milliseconds(250));
+    counter.add(std::chrono::milliseconds(500));
+    BOOST_CHECK_EQUAL(counter.getCount(), 2);
+    BOOST_CHECK_CLOSE(counter.getSeconds(), 0.75, 1e-6);
+
+    {
+        DurationCounter::Scope scope(counter);
+    }
+    BOOST_CHECK_EQUAL(counter.getCount(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(PrometheusText)
+{
+    std::string text;
+    PrometheusWriter writer(text);
+    writer.counter("messages_total", "Messages.", 42);
+    writer.header("buffered_bytes", "Buffered bytes.", "gauge");
+    writer.sample("buffered_bytes", 0.5, "connection=\"1\"");
+
+    DurationCounter counter;
+    counter.add(std::chrono::milliseconds(1500));
+    writer.durations("task", "Task.", counter);
+
+    BOOST_CHECK_EQUAL(text,
+                      "# HELP messages_total Messages.\n"
+                      "# TYPE messages_total counter\n"
+                      "messages_total 42\n"
+                      "# HELP buffered_bytes Buffered bytes.\n"
+                      "# TYPE buffered_bytes gauge\n"
+                      "buffered_bytes{connection=\"1\"} 0.5\n"
+                      "# HELP task_seconds Task.\n"
+                      "# TYPE task_seconds summary\n"
+                      "task_seconds_sum 1.5\n"
+                      "task_seconds_count 1\n");
+
+    BOOST_CHECK_EQUAL(PrometheusWriter::escapeLabel("a\"b\\c\nd"), "a\\\"b\\\\c\\nd");
+}
+
+BOOST_AUTO_TEST_CASE(HistogramBuckets)
+{
+    //the buckets are contiguous and cover all the durations
+    BOOST_CHECK_EQUAL(LatencyHistogram::getBucket(0), 0);
+    BOOST_CHECK_EQUAL(LatencyHistogram::getBucket(UINT64_MAX), LatencyHistogram::BUCKET_COUNT - 1);
+    for(unsigned int i = 1; i<LatencyHistogram::BUCKET_COUNT; i++)
+    {
+        uint64_t lowest = LatencyHistogram::getBucketLowest(i);
+        BOOST_REQUIRE_EQUAL(LatencyHistogram::getBucket(lowest), i);
+        BOOST_REQUIRE_EQUAL(LatencyHistogram::getBucket(lowest - 1), i - 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(HistogramPercentiles)
+{
+    LatencyHistogram histogram;
+    BOOST_CHECK_EQUAL(histogram.getPercentileSeconds(50), 0);
+
+    //1 to 1000 microseconds
+    for(int i = 1; i<=1000; i++)
+    {
+        histogram.record(std::chrono::microseconds(i));
+    }
+    BOOST_CHECK_EQUAL(histogram.getCount(), 1000);
+    BOOST_CHECK_CLOSE(histogram.getMaxSeconds(), 1e-3, 1e-6);
+    BOOST_CHECK_CLOSE(histogram.getSumSeconds(), 500500e-6, 1e-6);
+
+    //relative error of the buckets below 12.5%
+    BOOST_CHECK_CLOSE(histogram.getPercentileSeconds(50), 500e-6, 12.5);
+    BOOST_CHECK_CLOSE(histogram.getPercentileSeconds(99), 990e-6, 12.5);
+    BOOST_CHECK_CLOSE(histogram.getPercentileSeconds(100), 1e-3, 1e-6);
+
+    //the buckets below 2^17 ns are all below 131.072 us
+    uint64_t below = histogram.getCountBelow(131072e-9);
+    BOOST_CHECK(below <= 131 && below >= 120);
+    BOOST_CHECK_EQUAL(histogram.getCountBelow(10), 1000);
+
+    histogram.reset();
+    BOOST_CHECK_EQUAL(histogram.getCount(), 0);
+    BOOST_CHECK_EQUAL(histogram.getCountBelow(10), 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,1297 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+//Link to Boost
+ #define BOOST_TEST_DYN_LINK
+
+//Define our Module name (prints at testing)
+ #define BOOST_TEST_MODULE "WebInterfaceTest"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/filesystem.hpp>
+
+#include <InstantInterface/WebInterface.h>
+
+#include <websocketpp/config/asio_no_tls_client.hpp>
+#include <websocketpp/client.hpp>
+
+#include <json/json.h>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+using namespace InstantInterface;
+namespace fs = boost::filesystem;
+
+typedef websocketpp::client<websocketpp::config::asio_client> client;
+
+/**
+ * @brief websocket client running in its own thread, which records the messages received from the server
+ */
+class TestClient
+{
+public:
+    TestClient(uint16_t port, const std::string& subprotocol = "", int receiveBufferSize = 0) :
+        open(false), closed(false), paused(false), consumed(0)
+    {
+        endpoint.clear_access_channels(websocketpp::log::alevel::all);
+        endpoint.clear_error_channels(websocketpp::log::elevel::all);
+        endpoint.init_asio();
+        endpoint.start_perpetual();
+
+        endpoint.set_open_handler([this](websocketpp::connection_hdl)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            open = true;
+            signal.notify_all();
+        });
+        auto onClose = [this](websocketpp::connection_hdl)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+            signal.notify_all();
+        };
+        endpoint.set_close_handler(onClose);
+        endpoint.set_fail_handler(onClose);
+        endpoint.set_message_handler([this](websocketpp::connection_hdl, client::message_ptr msg)
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            //a paused client stops reading, so that the data accumulate on the side of the server
+            signal.wait(lock, [this]{ return !paused; });
+            messages.push_back(msg);
+            signal.notify_all();
+        });
+        if(receiveBufferSize > 0)
+        {
+            endpoint.set_socket_init_handler([receiveBufferSize](websocketpp::connection_hdl, boost::asio::ip::tcp::socket& socket)
+            {
+                socket.set_option(boost::asio::socket_base::receive_buffer_size(receiveBufferSize));
+            });
+        }
+
+        websocketpp::lib::error_code ec;
+        client::connection_ptr con = endpoint.get_connection("ws://127.0.0.1:" + std::to_string(port) + "/", ec);
+        BOOST_REQUIRE(!ec);
+        if(!subprotocol.empty())
+        {
+            con->add_subprotocol(subprotocol);
+        }
+        hdl = con->get_handle();
+        endpoint.connect(con);
+        thread = std::thread([this]{ endpoint.run(); });
+
+        std::unique_lock<std::mutex> lock(mutex);
+        BOOST_REQUIRE(signal.wait_for(lock, std::chrono::seconds(5), [this]{ return open || closed; }) && open);
+    }
+
+    ~TestClient()
+    {
+        setPaused(false);
+        websocketpp::lib::error_code ec;
+        endpoint.close(hdl, websocketpp::close::status::normal, "", ec);
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            signal.wait_for(lock, std::chrono::seconds(2), [this]{ return closed; });
+        }
+        endpoint.stop_perpetual();
+        endpoint.stop();
+        thread.join();
+    }
+
+    void send(const std::string& message)
+    {
+        websocketpp::lib::error_code ec;
+        endpoint.send(hdl, message, websocketpp::frame::opcode::text, ec);
+        BOOST_REQUIRE(!ec);
+    }
+
+    /**
+     * @brief returns the next json message of type \p type accepted by \p predicate, or a null value after \p timeout
+     */
+    Json::Value waitFor(const std::string& type, std::function<bool(const Json::Value&)> predicate = nullptr,
+                        std::chrono::milliseconds timeout = std::chrono::seconds(5))
+    {
+        Json::Value found;
+        std::unique_lock<std::mutex> lock(mutex);
+        signal.wait_for(lock, timeout, [&]
+        {
+            for(; consumed < messages.size(); consumed++)
+            {
+                Json::Value message;
+                Json::Reader reader;
+                if(messages[consumed]->get_opcode() == websocketpp::frame::opcode::text && reader.parse(messages[consumed]->get_payload(), message) &&
+                   message["type"].asString() == type && (!predicate || predicate(message)))
+                {
+                    found = message;
+                    consumed++;
+                    return true;
+                }
+            }
+            return closed;
+        });
+        return found;
+    }
+
+    /**
+     * @brief returns the number of messages of type \p type received so far
+     */
+    size_t count(const std::string& type)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        size_t n = 0;
+        for(auto& msg: messages)
+        {
+            Json::Value message;
+            Json::Reader reader;
+            if(reader.parse(msg->get_payload(), message) && message["type"].asString() == type)
+            {
+                n++;
+            }
+        }
+        return n;
+    }
+
+    void setPaused(bool value)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        paused = value;
+        signal.notify_all();
+    }
+
+    bool isClosed()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return closed;
+    }
+
+private:
+    client endpoint;
+    websocketpp::connection_hdl hdl;
+    std::thread thread;
+
+    std::mutex mutex;
+    std::condition_variable signal;
+    bool open;
+    bool closed;
+    bool paused;
+    std::vector<client::message_ptr> messages;
+    size_t consumed;
+};
+
+/**
+ * @brief returns an empty directory to serve as the web interface
+ */
+std::string makeDocroot()
+{
+    fs::path root = fs::temp_directory_path() / fs::unique_path();
+    fs::create_directories(root);
+    return root.string() + "/";
+}
+
+/**
+ * @brief waits until \p condition is true, at most \p timeout
+ */
+bool waitUntil(std::function<bool()> condition, std::chrono::milliseconds timeout = std::chrono::seconds(5))
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(!condition())
+    {
+        if(std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    return true;
+}
+
+std::string makeUpdate(const std::string& id, const std::string& value, uint64_t seq = 0)
+{
+    return "{\"type\":\"update\"," + (seq > 0 ? "\"seq\":" + std::to_string(seq) + "," : std::string()) +
+            "\"content\":[{\"id\":\"" + id + "\",\"value\":" + value + "}]}";
+}
+
+BOOST_AUTO_TEST_SUITE(TestOfWebInterface)
+
+BOOST_AUTO_TEST_CASE(UpdateCoalescing)
+{
+    int value = 0;
+    int sets = 0;
+    int actions = 0;
+
+    //the interface only keeps weak pointers to the elements
+    auto valueAttribute = AttributeFactory::makeAttribute<int>([&]{ return value; }, [&](int v){ value = v; sets++; });
+    auto action = AttributeFactory::makeAction([&]{ actions++; });
+
+    WebInterface s(true);
+    s.createGroup("group")
+            .addInteractionElement("value", valueAttribute)
+            .addInteractionElement("action", action);
+    s.setUpdateCoalescing(true);
+    s.init(29150, makeDocroot());
+    s.run();
+
+    {
+        TestClient c(29150);
+        c.send(makeUpdate("value", "1"));
+        c.send(makeUpdate("value", "2"));
+        c.send(makeUpdate("action", "null"));
+        c.send(makeUpdate("value", "3"));
+        c.send(makeUpdate("value", "4"));
+        BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == 5; }));
+
+        //a slider drag sets the attribute once per call, the actions are all executed
+        s.executeCommands();
+        BOOST_CHECK_EQUAL(value, 4);
+        BOOST_CHECK_EQUAL(sets, 1);
+        BOOST_CHECK_EQUAL(actions, 1);
+        BOOST_CHECK_EQUAL(s.getCoalescedUpdateCount(), 3u);
+        BOOST_CHECK_EQUAL(s.getCommandQueueDepth(), 0u);
+
+        //without coalescing, every value is applied
+        s.setUpdateCoalescing(false);
+        c.send(makeUpdate("value", "5"));
+        c.send(makeUpdate("value", "6"));
+        BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == 2; }));
+        s.executeCommands();
+        BOOST_CHECK_EQUAL(value, 6);
+        BOOST_CHECK_EQUAL(sets, 3);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(CoalescedUpdateLatencies)
+{
+    int value = 0;
+    auto valueAttribute = AttributeFactory::makeAttribute(&value);
+    auto slowAction = AttributeFactory::makeAction([]{ std::this_thread::sleep_for(std::chrono::milliseconds(100)); });
+
+    WebInterface s(true);
+    s.createGroup("group")
+            .addInteractionElement("value", valueAttribute)
+            .addInteractionElement("slow", slowAction);
+    s.setUpdateCoalescing(true);
+    s.init(29156, makeDocroot());
+    s.run();
+
+    {
+        TestClient c(29156);
+        c.send(makeUpdate("slow", "null"));
+        c.send(makeUpdate("value", "1"));
+        BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == 2; }));
+        s.resetLatencies();
+        s.executeCommands();
+        BOOST_CHECK_EQUAL(value, 1);
+
+        //the value waits for the slow action in the queue, but its own execution is fast
+        const LatencyHistogram& apply = s.getLatencyHistogram(WebInterface::LATENCY_APPLY);
+        const LatencyHistogram& queue = s.getLatencyHistogram(WebInterface::LATENCY_QUEUE);
+        BOOST_CHECK_EQUAL(apply.getCount(), 2u);
+        BOOST_CHECK_GE(apply.getMaxSeconds(), 0.1);
+        BOOST_CHECK_LT(apply.getSumSeconds(), 0.15);
+        BOOST_CHECK_GE(queue.getMaxSeconds(), 0.1);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(StructurePatches)
+{
+    int a = 0;
+    int b = 0;
+    auto aAttribute = AttributeFactory::makeAttribute(&a);
+    auto bAttribute = AttributeFactory::makeAttribute(&b);
+
+    WebInterface s(true);
+    InterfaceManager group = s.createGroup("group");
+    group.addInteractionElement("a", aAttribute);
+    s.init(29151, makeDocroot());
+    s.run();
+
+    {
+        TestClient patched(29151);
+        TestClient plain(29151);
+        patched.send("accept_patches");
+        patched.send("send_interface");
+        plain.send("send_interface");
+        BOOST_REQUIRE(!patched.waitFor("interface").isNull());
+        BOOST_REQUIRE(!plain.waitFor("interface").isNull());
+
+        //only the clients that have announced that they apply the patches receive them
+        group.addInteractionElement("b", bAttribute);
+        s.forceRefreshStructureAll();
+        Json::Value patch = patched.waitFor("patch");
+        BOOST_REQUIRE(!patch.isNull());
+        BOOST_CHECK_EQUAL(patch["content"][0]["group"].asString(), "group");
+        BOOST_CHECK_EQUAL(patch["content"][0]["node"]["name"].asString(), "b");
+        Json::Value structure = plain.waitFor("interface");
+        BOOST_REQUIRE(!structure.isNull());
+        BOOST_CHECK_EQUAL(structure["hash"].asString(), patch["hash"].asString());
+        BOOST_CHECK_EQUAL(plain.count("patch"), 0u);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(StructureRevalidation)
+{
+    int a = 0;
+    int b = 0;
+    auto aAttribute = AttributeFactory::makeAttribute(&a);
+    auto bAttribute = AttributeFactory::makeAttribute(&b);
+
+    WebInterface s(true);
+    InterfaceManager group = s.createGroup("group");
+    group.addInteractionElement("a", aAttribute);
+    s.init(29161, makeDocroot());
+    s.run();
+
+    std::string hash;
+    {
+        TestClient c(29161);
+        c.send("send_interface");
+        Json::Value structure = c.waitFor("interface");
+        BOOST_REQUIRE(!structure.isNull());
+        hash = structure["hash"].asString();
+        BOOST_REQUIRE(!hash.empty());
+    }
+
+    {
+        //the structure cached by the client is still valid, only the values are sent
+        TestClient c(29161);
+        c.send("send_interface " + hash);
+        Json::Value unchanged = c.waitFor("unchanged");
+        BOOST_REQUIRE(!unchanged.isNull());
+        BOOST_CHECK_EQUAL(unchanged["hash"].asString(), hash);
+        Json::Value update = c.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK_EQUAL(update["content"].size(), 1u);
+        BOOST_CHECK_EQUAL(c.count("interface"), 0u);
+    }
+
+    {
+        //a client with another structure receives the current one
+        TestClient c(29161);
+        c.send("send_interface 0123456789abcdef");
+        Json::Value structure = c.waitFor("interface");
+        BOOST_REQUIRE(!structure.isNull());
+        BOOST_CHECK_EQUAL(structure["hash"].asString(), hash);
+        BOOST_CHECK_EQUAL(structure["content"][0]["name"].asString(), "group");
+        BOOST_CHECK(!c.waitFor("update").isNull());
+        BOOST_CHECK_EQUAL(c.count("unchanged"), 0u);
+    }
+
+    //the hash changes with the structure
+    group.addInteractionElement("b", bAttribute);
+    s.forceRefreshStructureAll();
+    {
+        TestClient c(29161);
+        c.send("send_interface " + hash);
+        Json::Value structure = c.waitFor("interface");
+        BOOST_REQUIRE(!structure.isNull());
+        BOOST_CHECK(structure["hash"].asString() != hash);
+        BOOST_CHECK_EQUAL(structure["content"][0]["content"].size(), 2u);
+        BOOST_CHECK_EQUAL(c.count("unchanged"), 0u);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(EchoSuppressionAndAcknowledgements)
+{
+    int value = 0;
+    auto valueAttribute = AttributeFactory::makeAttribute(&value);
+
+    WebInterface s(true);
+    s.createGroup("group").addInteractionElement("value", valueAttribute);
+    s.setDeltaRefresh(true, 0);
+    s.init(29152, makeDocroot());
+    s.run();
+
+    {
+        TestClient editor(29152);
+        TestClient viewer(29152);
+        editor.send("send_interface");
+        viewer.send("send_interface");
+        BOOST_REQUIRE(!editor.waitFor("update").isNull());
+        BOOST_REQUIRE(!viewer.waitFor("update").isNull());
+
+        editor.send(makeUpdate("value", "42", 7));
+        BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == 1; }));
+        s.executeCommands();
+        BOOST_CHECK_EQUAL(value, 42);
+        s.forceRefreshAll();
+
+        //the other clients receive the new value, the editor only the acknowledgement of its edit
+        Json::Value update = viewer.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), 42);
+        Json::Value ack = editor.waitFor("ack");
+        BOOST_REQUIRE(!ack.isNull());
+        BOOST_CHECK_EQUAL(ack["seq"].asUInt64(), 7u);
+        BOOST_CHECK(editor.waitFor("update", nullptr, std::chrono::milliseconds(200)).isNull());
+        BOOST_CHECK_EQUAL(viewer.count("ack"), 0u);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(OverriddenEditReachesEditor)
+{
+    //the program clamps the values set by the clients
+    int value = 0;
+    auto valueAttribute = AttributeFactory::makeAttribute<int>([&]{ return value; }, [&](int v){ value = std::min(v, 10); });
+
+    WebInterface s(true);
+    s.createGroup("group").addInteractionElement("value", valueAttribute);
+    s.setDeltaRefresh(true, 0);
+    s.init(29160, makeDocroot());
+    s.run();
+
+    {
+        TestClient editor(29160);
+        editor.send("send_interface");
+        BOOST_REQUIRE(!editor.waitFor("update").isNull());
+        s.forceRefreshAll();
+
+        //the client ignores the values of an element until its edit is acknowledged, so the values which override the edit
+        //must come after the acknowledgement (waitFor() only looks at the messages after the last one returned)
+        editor.send(makeUpdate("value", "42", 1));
+        BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == 1; }));
+        s.executeCommands();
+        BOOST_CHECK_EQUAL(value, 10);
+        s.forceRefreshAll();
+        Json::Value ack = editor.waitFor("ack");
+        BOOST_REQUIRE(!ack.isNull());
+        BOOST_CHECK_EQUAL(ack["seq"].asUInt64(), 1u);
+        Json::Value update = editor.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), 10);
+
+        //the same for a value changed by the program after the edit
+        editor.send(makeUpdate("value", "3", 2));
+        BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == 1; }));
+        s.executeCommands();
+        value = 4;
+        s.forceRefreshAll();
+        ack = editor.waitFor("ack");
+        BOOST_REQUIRE(!ack.isNull());
+        BOOST_CHECK_EQUAL(ack["seq"].asUInt64(), 2u);
+        update = editor.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), 4);
+    }
+
+    s.stop();
+}
+
+/**
+ * @brief interface with many attributes, whose update messages are large enough to fill the socket buffers
+ */
+struct LargeInterface
+{
+    LargeInterface()
+    {
+        values.resize(16384, 0);
+        for(auto& value: values)
+        {
+            attributes.push_back(AttributeFactory::makeAttribute(&value));
+        }
+    }
+
+    void add(WebInterface& s)
+    {
+        InterfaceManager group = s.createGroup("group");
+        for(size_t i = 0; i<attributes.size(); i++)
+        {
+            group.addInteractionElement("v" + std::to_string(i), attributes[i]);
+        }
+    }
+
+    void set(int value)
+    {
+        for(auto& v: values)
+        {
+            v = value;
+        }
+    }
+
+    std::vector<int> values;
+    std::vector<std::shared_ptr<AttributeT<int> > > attributes;
+};
+
+BOOST_AUTO_TEST_CASE(Backpressure)
+{
+    LargeInterface large;
+
+    WebInterface s(true);
+    large.add(s);
+    s.setBackpressure(64*1024);
+    s.init(29153, makeDocroot());
+    s.run();
+
+    {
+        //the client reads slowly through a small receive buffer
+        TestClient c(29153, "", 4096);
+        c.send("send_interface");
+        BOOST_REQUIRE(!c.waitFor("update").isNull());
+
+        //once the client stops reading, the broadcasts fill its send buffer up to the limit and are then skipped
+        c.setPaused(true);
+        int broadcasts = 0;
+        while(s.getDeferredBroadcastCount() == 0 && broadcasts < 200)
+        {
+            large.set(++broadcasts);
+            s.forceRefreshAll();
+        }
+        BOOST_REQUIRE_GT(s.getDeferredBroadcastCount(), 0u);
+        WebInterface::Metrics metrics = s.getMetrics();
+        BOOST_REQUIRE_EQUAL(metrics.connections.size(), 1u);
+        size_t buffered = metrics.connections[0].bufferedBytes;
+        for(int i = 0; i<10; i++)
+        {
+            large.set(++broadcasts);
+            s.forceRefreshAll();
+        }
+        //nothing more is queued for the slow client
+        metrics = s.getMetrics();
+        BOOST_REQUIRE_EQUAL(metrics.connections.size(), 1u);
+        BOOST_CHECK_LE(metrics.connections[0].bufferedBytes, buffered);
+
+        //after catching up, the client receives the latest values, whatever happened in between
+        large.set(-1);
+        s.forceRefreshAll();
+        c.setPaused(false);
+        Json::Value update;
+        for(int i = 0; i<100 && update.isNull(); i++)
+        {
+            update = c.waitFor("update", [](const Json::Value& message){ return message["content"][0]["value"].asInt() == -1; },
+                    std::chrono::milliseconds(50));
+            if(update.isNull())
+            {
+                s.forceRefreshAll();
+            }
+        }
+        BOOST_CHECK(!update.isNull());
+        BOOST_CHECK_LT(c.count("update"), 1u + broadcasts);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(LaggingClientDisconnected)
+{
+    LargeInterface large;
+
+    WebInterface s(true);
+    large.add(s);
+    s.setBackpressure(64*1024, std::chrono::milliseconds(100));
+    s.init(29154, makeDocroot());
+    s.run();
+
+    {
+        TestClient lagging(29154, "", 4096);
+        TestClient reader(29154);
+        lagging.send("send_interface");
+        reader.send("send_interface");
+        BOOST_REQUIRE(!lagging.waitFor("update").isNull());
+        BOOST_REQUIRE(!reader.waitFor("update").isNull());
+
+        //a client that stays over the limit for longer than the maximum lag is disconnected, the others are not affected
+        lagging.setPaused(true);
+        int broadcasts = 0;
+        bool disconnected = waitUntil([&]
+        {
+            large.set(++broadcasts);
+            s.forceRefreshAll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            return s.getMetrics().connections.size() == 1;
+        }, std::chrono::seconds(10));
+        BOOST_CHECK(disconnected);
+        lagging.setPaused(false);
+        BOOST_CHECK(waitUntil([&]{ return lagging.isClosed(); }));
+        BOOST_CHECK(!reader.isClosed());
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(ResumeFromLog)
+{
+    int a = 0;
+    int b = 0;
+    auto aAttribute = AttributeFactory::makeAttribute(&a);
+    auto bAttribute = AttributeFactory::makeAttribute(&b);
+
+    WebInterface s(true);
+    s.createGroup("g1").addInteractionElement("a", aAttribute);
+    s.createGroup("g2").addInteractionElement("b", bAttribute);
+    s.setDeltaRefresh(true, 0);
+    s.setResumeCapacity(16);
+    s.init(29155, makeDocroot());
+    s.run();
+    s.forceRefreshAll();
+
+    std::string session;
+    std::string hash;
+    uint64_t version = 0;
+    {
+        TestClient c(29155);
+        c.send("send_interface");
+        Json::Value structure = c.waitFor("interface");
+        Json::Value update = c.waitFor("update");
+        BOOST_REQUIRE(!structure.isNull() && !update.isNull());
+        session = structure["session"].asString();
+        hash = structure["hash"].asString();
+        version = update["version"].asUInt64();
+        BOOST_REQUIRE_GT(version, 0u);
+    }
+
+    //changes broadcast while the client is disconnected
+    a = 1;
+    s.forceRefreshAll();
+    b = 2;
+    s.forceRefreshAll();
+    std::string resume = "resume " + session + " " + std::to_string(version) + " " + hash;
+
+    {
+        //the deltas broadcast since the version of the client are sent again
+        TestClient c(29155);
+        c.send(resume);
+        Json::Value first = c.waitFor("update");
+        Json::Value second = c.waitFor("update");
+        BOOST_REQUIRE(!first.isNull() && !second.isNull());
+        BOOST_CHECK_EQUAL(first["content"].size(), 1u);
+        BOOST_CHECK_EQUAL(first["content"][0]["id"].asString(), "a");
+        BOOST_CHECK_EQUAL(second["content"][0]["id"].asString(), "b");
+        BOOST_CHECK_EQUAL(second["content"][0]["value"].asInt(), 2);
+        BOOST_CHECK_EQUAL(c.count("interface"), 0u);
+    }
+
+    {
+        //a client with subscriptions only receives the values of its groups
+        TestClient c(29155);
+        c.send("subscribe g2");
+        c.send(resume);
+        //the reply to the subscription, then the one to the resume
+        for(int i = 0; i<2; i++)
+        {
+            Json::Value update = c.waitFor("update");
+            BOOST_REQUIRE(!update.isNull());
+            BOOST_REQUIRE_EQUAL(update["content"].size(), 1u);
+            BOOST_CHECK_EQUAL(update["content"][0]["id"].asString(), "b");
+            BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), 2);
+        }
+        BOOST_CHECK(c.waitFor("update", nullptr, std::chrono::milliseconds(200)).isNull());
+        BOOST_CHECK_EQUAL(c.count("interface"), 0u);
+    }
+
+    {
+        //after a restart of the server, the client receives all the values (its structure is still valid)
+        TestClient c(29155);
+        c.send("resume 0000000000000000 " + std::to_string(version) + " " + hash);
+        BOOST_CHECK(!c.waitFor("unchanged").isNull());
+        Json::Value update = c.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK_EQUAL(update["content"].size(), 2u);
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_CASE(SnapshotPublication)
+{
+    int a = 0;
+    int b = 0;
+    auto aAttribute = AttributeFactory::makeAttribute(&a);
+    auto bAttribute = AttributeFactory::makeAttribute(&b);
+
+    WebInterface s(true);
+    s.createGroup("g1").addInteractionElement("a", aAttribute);
+    s.createGroup("g2").addInteractionElement("b", bAttribute);
+    s.setDeltaRefresh(true, 0);
+    s.init(29157, makeDocroot());
+    s.run();
+    s.forceRefreshAll();
+
+    {
+        TestClient all(29157);
+        TestClient subscribed(29157);
+        all.send("send_interface");
+        subscribed.send("subscribe g2");
+        subscribed.send("send_interface");
+        BOOST_REQUIRE(!all.waitFor("update").isNull());
+        BOOST_REQUIRE(!subscribed.waitFor("update").isNull());
+        BOOST_REQUIRE(!subscribed.waitFor("update").isNull());
+
+        //the snapshots are recycled, each broadcast must only contain the values changed since the previous one
+        for(int i = 1; i<=50; i++)
+        {
+            if(i%2)
+            {
+                a = i;
+            }
+            else
+            {
+                b = i;
+            }
+            s.forceRefreshAll();
+            Json::Value update = all.waitFor("update");
+            BOOST_REQUIRE(!update.isNull());
+            BOOST_REQUIRE_EQUAL(update["content"].size(), 1u);
+            BOOST_CHECK_EQUAL(update["content"][0]["id"].asString(), i%2 ? "a" : "b");
+            BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), i);
+            if(i%2 == 0)
+            {
+                update = subscribed.waitFor("update");
+                BOOST_REQUIRE(!update.isNull());
+                BOOST_REQUIRE_EQUAL(update["content"].size(), 1u);
+                BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), i);
+            }
+        }
+        //nothing has changed, nothing is sent
+        s.forceRefreshAll();
+        BOOST_CHECK(all.waitFor("update", nullptr, std::chrono::milliseconds(200)).isNull());
+        BOOST_CHECK(subscribed.waitFor("update", nullptr, std::chrono::milliseconds(10)).isNull());
+
+        //the whole values are still served from the recycled snapshots
+        all.send("update");
+        Json::Value update = all.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK_EQUAL(update["content"].size(), 2u);
+    }
+
+    s.stop();
+}
+
+/**
+ * @brief returns the ids of the values of the update message \p update, sorted
+ */
+std::vector<std::string> getUpdateIds(const Json::Value& update)
+{
+    std::vector<std::string> ids;
+    for(auto& item: update["content"])
+    {
+        ids.push_back(item["id"].asString());
+    }
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+BOOST_AUTO_TEST_CASE(GroupSubscriptions)
+{
+    int a = 0;
+    int b = 0;
+    int c = 0;
+    int d = 0;
+    auto aAttribute = AttributeFactory::makeAttribute(&a);
+    auto bAttribute = AttributeFactory::makeAttribute(&b);
+    auto cAttribute = AttributeFactory::makeAttribute(&c);
+    auto dAttribute = AttributeFactory::makeAttribute(&d);
+
+    WebInterface s(true);
+    InterfaceManager g1 = s.createGroup("g1");
+    g1.addInteractionElement("a", aAttribute);
+    g1.createGroup("sub").addInteractionElement("c", cAttribute);
+    s.createGroup("g2").addInteractionElement("b", bAttribute);
+    s.createGroup("g10").addInteractionElement("d", dAttribute);
+    s.init(29162, makeDocroot());
+    s.run();
+
+    {
+        TestClient first(29162);
+        TestClient second(29162);
+        first.send("subscribe g1");
+        second.send("subscribe g2");
+
+        //a subscription includes the subgroups, but not the groups whose name only starts like it
+        const std::vector<std::string> firstIds = {"a", "c"};
+        const std::vector<std::string> secondIds = {"b"};
+        Json::Value update = first.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK(getUpdateIds(update) == firstIds);
+        update = second.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK(getUpdateIds(update) == secondIds);
+
+        //each broadcast only carries the values of the groups of the client
+        a = 1;
+        b = 2;
+        c = 3;
+        d = 4;
+        s.forceRefreshAll();
+        update = first.waitFor("update", [](const Json::Value& u){ return u["content"][0]["value"].asInt() != 0; });
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK(getUpdateIds(update) == firstIds);
+        for(auto& item: update["content"])
+        {
+            BOOST_CHECK_EQUAL(item["value"].asInt(), item["id"].asString() == "a" ? 1 : 3);
+        }
+        update = second.waitFor("update", [](const Json::Value& u){ return u["content"][0]["value"].asInt() != 0; });
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK(getUpdateIds(update) == secondIds);
+        BOOST_CHECK_EQUAL(update["content"][0]["value"].asInt(), 2);
+
+        //without any subscription left, the client receives all the values again (the messages are handled in order)
+        second.send("unsubscribe g2");
+        second.send("update");
+        update = second.waitFor("update", [](const Json::Value& u){ return u["content"].size() == 4; });
+        BOOST_REQUIRE(!update.isNull());
+        b = 5;
+        s.forceRefreshAll();
+        update = second.waitFor("update", [](const Json::Value& u){ return u["content"].size() == 4; });
+        BOOST_REQUIRE(!update.isNull());
+        update = first.waitFor("update");
+        BOOST_REQUIRE(!update.isNull());
+        BOOST_CHECK(getUpdateIds(update) == firstIds);
+    }
+
+    s.stop();
+}
+
+/**
+ * @brief returns true if \p fd becomes readable within \p timeout
+ */
+bool isReadable(int fd, int timeout = 0)
+{
+    pollfd pfd = {fd, POLLIN, 0};
+    return ::poll(&pfd, 1, timeout) > 0 && (pfd.revents & POLLIN);
+}
+
+BOOST_AUTO_TEST_CASE(CommandWakeups)
+{
+    int value = 0;
+    auto valueAttribute = AttributeFactory::makeAttribute(&value);
+
+    WebInterface s(true);
+    s.createGroup("group").addInteractionElement("value", valueAttribute);
+    s.init(29158, makeDocroot());
+    s.run();
+
+    {
+        TestClient c(29158);
+
+        //waitForCommands() times out without command, and returns as soon as one is received
+        BOOST_CHECK(!s.waitForCommands(std::chrono::milliseconds(20)));
+        std::thread sender([&]
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+            c.send(makeUpdate("value", "1"));
+        });
+        auto start = std::chrono::steady_clock::now();
+        BOOST_CHECK(s.waitForCommands(std::chrono::seconds(5)));
+        BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(2));
+        sender.join();
+        s.executeCommands();
+        BOOST_CHECK_EQUAL(value, 1);
+
+        //the descriptor is readable while commands are waiting, and not anymore once executeCommands() has emptied the queue
+        int fd = s.getCommandFd();
+        BOOST_REQUIRE_GE(fd, 0);
+        BOOST_CHECK(!isReadable(fd));
+        for(int i = 0; i<200; i++)
+        {
+            int count = 1 + i%3;
+            for(int j = 0; j<count; j++)
+            {
+                c.send(makeUpdate("value", std::to_string(i)));
+            }
+            BOOST_REQUIRE(isReadable(fd, 5000));
+            BOOST_REQUIRE(waitUntil([&]{ return s.getCommandQueueDepth() == (size_t)count; }));
+            s.executeCommands();
+            BOOST_REQUIRE_EQUAL(s.getCommandQueueDepth(), 0u);
+            BOOST_REQUIRE(!isReadable(fd));
+        }
+        BOOST_CHECK_EQUAL(value, 199);
+
+        //an executeCommands() run while the commands arrive leaves the descriptor readable only if commands are left
+        for(int i = 0; i<200; i++)
+        {
+            c.send(makeUpdate("value", std::to_string(i)));
+            s.executeCommands();
+        }
+        BOOST_REQUIRE(waitUntil([&]
+        {
+            if(isReadable(fd))
+            {
+                s.executeCommands();
+            }
+            return value == 199 && s.getCommandQueueDepth() == 0;
+        }));
+        s.executeCommands();
+        BOOST_CHECK(!isReadable(fd));
+    }
+
+    s.stop();
+}
+
+/**
+ * @brief runs the event loop of a WebInterface without thread on its file descriptors, until \p condition is true
+ */
+bool runEventLoop(WebInterface& s, std::function<bool()> condition, std::chrono::milliseconds timeout = std::chrono::seconds(5))
+{
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    while(!condition())
+    {
+        if(std::chrono::steady_clock::now() > deadline)
+        {
+            return false;
+        }
+        std::vector<pollfd> pfds;
+        for(int fd: s.getFileDescriptors())
+        {
+            pfds.push_back(pollfd{fd, POLLIN, 0});
+        }
+        ::poll(pfds.data(), pfds.size(), (int)s.getPollTimeout(std::chrono::milliseconds(10)).count());
+        s.poll(0, std::chrono::microseconds(0));
+    }
+    return true;
+}
+
+/**
+ * @brief returns true if one of the file descriptors of \p s becomes readable within \p timeout, without running the server
+ */
+bool waitReadable(WebInterface& s, int timeout = 5000)
+{
+    std::vector<pollfd> pfds;
+    for(int fd: s.getFileDescriptors())
+    {
+        pfds.push_back(pollfd{fd, POLLIN, 0});
+    }
+    return ::poll(pfds.data(), pfds.size(), timeout) > 0;
+}
+
+BOOST_AUTO_TEST_CASE(ExternalEventLoop)
+{
+    int value = 0;
+    int actions = 0;
+    auto valueAttribute = AttributeFactory::makeAttribute(&value);
+    auto slowAction = AttributeFactory::makeAction([&]{ actions++; std::this_thread::sleep_for(std::chrono::milliseconds(5)); });
+
+    WebInterface s(false);
+    s.createGroup("group")
+            .addInteractionElement("value", valueAttribute)
+            .addInteractionElement("slow", slowAction);
+    s.init(29159, makeDocroot());
+    s.setBroadcastRate(0);
+    s.poll(0, std::chrono::microseconds(0));
+
+    //only the listening socket until a client connects
+    BOOST_CHECK_EQUAL(s.getFileDescriptors().size(), 1u);
+    BOOST_CHECK_EQUAL(s.getPollTimeout(std::chrono::milliseconds(100)).count(), 100);
+
+    //the client is connected and disconnected by another thread, the server only runs in the event loop
+    std::unique_ptr<TestClient> c;
+    std::atomic<bool> done(false);
+    std::thread connecting([&]{ c.reset(new TestClient(29159)); done = true; });
+    BOOST_REQUIRE(runEventLoop(s, [&]{ return done.load(); }));
+    connecting.join();
+    BOOST_CHECK_EQUAL(s.getFileDescriptors().size(), 2u);
+
+    c->send("send_interface");
+    BOOST_REQUIRE(runEventLoop(s, [&]{ return c->count("update") > 0; }));
+    BOOST_CHECK_EQUAL(c->count("interface"), 1u);
+
+    //the commands are executed by poll(), in the thread of the program
+    c->send(makeUpdate("value", "3"));
+    BOOST_REQUIRE(runEventLoop(s, [&]{ return value == 3; }));
+
+    //a poll() that runs out of handlers asks to be called again right away
+    c->send("update");
+    c->send("update");
+    BOOST_REQUIRE(waitReadable(s));
+    BOOST_CHECK_EQUAL(s.poll(1, std::chrono::microseconds(0)), 1u);
+    BOOST_CHECK_EQUAL(s.getPollTimeout().count(), 0);
+    BOOST_REQUIRE(runEventLoop(s, [&]{ return c->count("update") >= 3; }));
+
+    //same when it runs out of time, after the handler in progress
+    while(s.poll(0, std::chrono::microseconds(0)) > 0)
+    {
+    }
+    c->send(makeUpdate("slow", "null"));
+    BOOST_REQUIRE(waitReadable(s));
+    auto start = std::chrono::steady_clock::now();
+    BOOST_CHECK_EQUAL(s.poll(0, std::chrono::microseconds(1)), 1u);
+    BOOST_CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(1));
+    BOOST_CHECK_EQUAL(actions, 1);
+    BOOST_CHECK_EQUAL(s.getPollTimeout().count(), 0);
+
+    //once all the ready handlers have run, the event loop can wait
+    while(s.poll(0, std::chrono::microseconds(0)) > 0)
+    {
+    }
+    BOOST_CHECK_EQUAL(s.getPollTimeout(std::chrono::milliseconds(100)).count(), 100);
+
+    done = false;
+    std::thread disconnecting([&]{ c.reset(); done = true; });
+    BOOST_REQUIRE(runEventLoop(s, [&]{ return done.load() && s.getFileDescriptors().size() == 1; }));
+    disconnecting.join();
+
+    s.stop();
+}
+
+/**
+ * @brief websocket client on a plain socket, which receives the frames as they are written by the server
+ * (websocketpp would inflate them itself)
+ */
+class RawClient
+{
+public:
+    struct Frame
+    {
+        bool compressed;
+        int opcode;
+        std::string payload;
+    };
+
+    RawClient(uint16_t port, const std::string& extensions) : fd(::socket(AF_INET, SOCK_STREAM, 0))
+    {
+        sockaddr_in address = sockaddr_in();
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        BOOST_REQUIRE(fd >= 0 && ::connect(fd, (sockaddr*)&address, sizeof(address)) == 0);
+
+        write("GET / HTTP/1.1\r\nHost: 127.0.0.1\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n"
+              "Sec-WebSocket-Extensions: " + extensions + "\r\n\r\n");
+        size_t end;
+        while((end = buffer.find("\r\n\r\n")) == std::string::npos)
+        {
+            BOOST_REQUIRE(fill());
+        }
+        response = buffer.substr(0, end+4);
+        buffer.erase(0, end+4);
+    }
+
+    ~RawClient()
+    {
+        ::close(fd);
+    }
+
+    /**
+     * @brief sends the text message \p message, masked with a null key
+     */
+    void send(const std::string& message)
+    {
+        BOOST_REQUIRE_LT(message.size(), 126u);
+        std::string frame = {char(0x81), char(0x80 | message.size()), 0, 0, 0, 0};
+        write(frame + message);
+    }
+
+    /**
+     * @brief reads the next frame into \p frame
+     * @return false if no frame has been received after \p timeout ms
+     */
+    bool readFrame(Frame& frame, int timeout = 5000)
+    {
+        size_t headerSize = 2;
+        uint64_t size = 0;
+        while(true)
+        {
+            if(buffer.size() >= 2)
+            {
+                size = buffer[1] & 0x7f;
+                headerSize = size == 126 ? 4 : size == 127 ? 10 : 2;
+                if(buffer.size() >= headerSize)
+                {
+                    if(headerSize > 2)
+                    {
+                        size = 0;
+                        for(size_t i = 2; i<headerSize; i++)
+                        {
+                            size = (size << 8) | (unsigned char)buffer[i];
+                        }
+                    }
+                    if(buffer.size() >= headerSize + size)
+                    {
+                        break;
+                    }
+                }
+            }
+            if(!fill(timeout))
+            {
+                return false;
+            }
+        }
+        frame.compressed = (buffer[0] & 0x40) != 0;
+        frame.opcode = buffer[0] & 0x0f;
+        frame.payload = buffer.substr(headerSize, size);
+        buffer.erase(0, headerSize + size);
+        return true;
+    }
+
+    std::string response;
+
+private:
+    void write(const std::string& data)
+    {
+        BOOST_REQUIRE_EQUAL(::send(fd, data.data(), data.size(), 0), (ssize_t)data.size());
+    }
+
+    bool fill(int timeout = 5000)
+    {
+        char data[65536];
+        if(!isReadable(fd, timeout))
+        {
+            return false;
+        }
+        ssize_t n = ::recv(fd, data, sizeof(data), 0);
+        if(n <= 0)
+        {
+            return false;
+        }
+        buffer.append(data, n);
+        return true;
+    }
+
+    int fd;
+    std::string buffer;
+};
+
+/**
+ * @brief inflates the payload \p payload of a permessage-deflate message with \p stream, which keeps the context of the previous messages
+ */
+bool inflateMessage(z_stream& stream, std::string payload, std::string& output)
+{
+    //the sender has removed the empty block of the sync flush (RFC 7692 section 7.2.2)
+    payload.append("\x00\x00\xff\xff", 4);
+    stream.next_in = (Bytef*)&payload[0];
+    stream.avail_in = payload.size();
+    output.clear();
+    char data[16384];
+    do
+    {
+        stream.next_out = (Bytef*)data;
+        stream.avail_out = sizeof(data);
+        int result = inflate(&stream, Z_SYNC_FLUSH);
+        if(result != Z_OK && result != Z_BUF_ERROR)
+        {
+            return false;
+        }
+        output.append(data, sizeof(data) - stream.avail_out);
+    }
+    while(stream.avail_in > 0 || stream.avail_out == 0);
+    return true;
+}
+
+BOOST_AUTO_TEST_CASE(DeflatedFrames)
+{
+    std::vector<int> values(64, 0);
+    std::vector<std::shared_ptr<AttributeT<int> > > attributes;
+    WebInterface s(true);
+    InterfaceManager group = s.createGroup("group");
+    for(size_t i = 0; i<values.size(); i++)
+    {
+        attributes.push_back(AttributeFactory::makeAttribute(&values[i]));
+        group.addInteractionElement("value" + std::to_string(i), attributes.back());
+    }
+    s.setCompression(true, 256);
+    s.init(29163, makeDocroot());
+    s.run();
+
+    {
+        TestClient plain(29163);
+        RawClient deflate(29163, "permessage-deflate; client_max_window_bits");
+        BOOST_REQUIRE(deflate.response.find(" 101 ") != std::string::npos);
+        BOOST_REQUIRE(deflate.response.find("permessage-deflate") != std::string::npos);
+
+        plain.send("send_interface");
+        deflate.send("send_interface");
+        std::vector<Json::Value> expected;
+        expected.push_back(plain.waitFor("interface"));
+        expected.push_back(plain.waitFor("update"));
+        for(int& value: values)
+        {
+            value = 7;
+        }
+        s.forceRefreshAll();
+        expected.push_back(plain.waitFor("update", [](const Json::Value& u){ return u["content"][0]["value"].asInt() == 7; }));
+
+        //the client inflates the messages with a single raw inflate stream, which keeps the context from message to message
+        z_stream stream = z_stream();
+        BOOST_REQUIRE_EQUAL(inflateInit2(&stream, -15), Z_OK);
+        std::vector<RawClient::Frame> frames;
+        for(auto& message: expected)
+        {
+            BOOST_REQUIRE(!message.isNull());
+            RawClient::Frame frame;
+            BOOST_REQUIRE(deflate.readFrame(frame));
+            BOOST_CHECK_EQUAL(frame.opcode, 1);
+            BOOST_CHECK(frame.compressed);
+
+            std::string inflated;
+            BOOST_REQUIRE(inflateMessage(stream, frame.payload, inflated));
+            BOOST_CHECK_LT(frame.payload.size(), inflated.size());
+            Json::Value received;
+            Json::Reader reader;
+            BOOST_REQUIRE(reader.parse(inflated, received));
+            BOOST_CHECK(received == message);
+            frames.push_back(frame);
+        }
+        inflateEnd(&stream);
+
+        //the same compressed frames are shared by all the connections, so they don't refer to the previous messages:
+        //the last one inflates the same without the context of the first ones
+        BOOST_REQUIRE_EQUAL(inflateInit2(&stream, -15), Z_OK);
+        std::string alone;
+        BOOST_REQUIRE(inflateMessage(stream, frames.back().payload, alone));
+        inflateEnd(&stream);
+        Json::Value received;
+        Json::Reader reader;
+        BOOST_REQUIRE(reader.parse(alone, received));
+        BOOST_CHECK(received == expected.back());
+    }
+
+    s.stop();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,112 @@
+/*M///////////////////////////////////////////////////////////////////////////////////////
+//
+//  IMPORTANT: READ BEFORE DOWNLOADING, COPYING, INSTALLING OR USING.
+//
+//  By downloading, copying, installing or using the software you agree to this license.
+//  If you do not agree to this license, do not download, install,
+//  copy or use the software.
+//
+//                           License Agreement
+//                      For InstantInterface Library
+//
+// The MIT License (MIT)
+//
+// Copyright (c) 2016 Matthieu Fraissinet-Tachet (www.matthieu-ft.com)
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy of
+// this software and associated documentation files (the "Software"), to deal in
+// the Software without restriction, including without limitation the rights to use,
+//  copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+// the Software, and to permit persons to whom the Software is furnished to do so,
+//  subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all copies
+//  or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED,
+// INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR
+// PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE
+// FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE
+// OR OTHER DEALINGS IN THE SOFTWARE.
+//
+//M*/
+
+//Link to Boost
+ #define BOOST_TEST_DYN_LINK
+
+//Define our Module name (prints at testing)
+ #define BOOST_TEST_MODULE "WireCodecTest"
+
+#include <boost/test/unit_test.hpp>
+
+#include <InstantInterface/WireCodec.h>
+#include <json/json.h>
+
+#include <string>
+
+using namespace std;
+using namespace InstantInterface;
+
+BOOST_AUTO_TEST_SUITE(TestOfWireCodec)
+
+const std::string message = "{\"type\":\"update\",\"content\":[{\"id\":\"a\",\"value\":-3},{\"id\":\"b\",\"value\":0.5},"
+                            "{\"id\":\"c\",\"value\":true},{\"id\":\"d\",\"value\":\"text\"},{\"id\":\"e\",\"value\":null},"
+                            "{\"id\":\"f\",\"value\":100000},{\"id\":\"g\",\"value\":-200}]}";
+
+void checkRoundTrip(const WireCodec& codec)
+{
+    Json::Value expected;
+    Json::Reader reader;
+    BOOST_REQUIRE(reader.parse(message, expected));
+
+    std::string payload;
+    BOOST_REQUIRE(codec.encode(message, payload));
+    BOOST_CHECK(payload.size() < message.size());
+
+    Json::Value decoded;
+    BOOST_REQUIRE(codec.decode(payload, decoded));
+    BOOST_CHECK(decoded == expected);
+
+    //truncated payloads are rejected
+    for(size_t size = 0; size<payload.size(); size++)
+    {
+        BOOST_CHECK(!codec.decode(payload.substr(0, size), decoded));
+    }
+
+    BOOST_CHECK(!codec.encode("{not json", payload));
+}
+
+BOOST_AUTO_TEST_CASE(MessagePack)
+{
+    MessagePackCodec codec;
+    checkRoundTrip(codec);
+
+    //plain commands are strings
+    std::string payload;
+    BOOST_REQUIRE(codec.encode("\"update\"", payload));
+    BOOST_CHECK_EQUAL(payload, std::string("\xa6update"));
+
+    std::string map("\x81\xa1\x61\xcd\x01\x00", 6);
+    Json::Value decoded;
+    BOOST_REQUIRE(codec.decode(map, decoded));
+    BOOST_CHECK_EQUAL(decoded["a"].asInt(), 256);
+}
+
+BOOST_AUTO_TEST_CASE(Cbor)
+{
+    CborCodec codec;
+    checkRoundTrip(codec);
+
+    std::string payload;
+    BOOST_REQUIRE(codec.encode("[-1,24]", payload));
+    BOOST_CHECK_EQUAL(payload, std::string("\x82\x20\x18\x18"));
+
+    //half precision float, and indefinite length (unsupported)
+    Json::Value decoded;
+    BOOST_REQUIRE(codec.decode(std::string("\xf9\x3e\x00", 3), decoded));
+    BOOST_CHECK_EQUAL(decoded.asDouble(), 1.5);
+    BOOST_CHECK(!codec.decode(std::string("\x9f\xff", 2), decoded));
+}
+
+BOOST_AUTO_TEST_SUITE_END()